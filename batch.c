@@ -0,0 +1,549 @@
+#include "batch.h"
+#include "pipeline.h"
+#include "stream.h"
+#include "parallel.h"
+#include "profile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <dirent.h>
+#include <glob.h>
+#include <sys/stat.h>
+#endif
+
+// Список путей входных файлов
+typedef struct {
+    char** paths;
+    int count;
+    int capacity;
+} PathList;
+
+// Задание пакета: файлы раздаются рабочим потокам по одному
+typedef struct {
+    const PathList* inputs;
+    const char* output_pattern;
+    const FilterStep* steps;
+    int step_count;
+    ImageLayout layout;
+    bool stream_mode;
+    bool* failed;  // Признак ошибки для каждого файла
+} BatchTask;
+
+static bool path_list_add(PathList* list, const char* path, size_t length) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity > 0 ? list->capacity * 2 : 64;
+        char** paths = (char**)realloc(list->paths, capacity * sizeof(char*));
+        if (!paths) {
+            return false;
+        }
+        list->paths = paths;
+        list->capacity = capacity;
+    }
+
+    char* copy = (char*)malloc(length + 1);
+    if (!copy) {
+        return false;
+    }
+    memcpy(copy, path, length);
+    copy[length] = '\0';
+
+    list->paths[list->count++] = copy;
+    return true;
+}
+
+static void path_list_free(PathList* list) {
+    for (int i = 0; i < list->count; i++) {
+        free(list->paths[i]);
+    }
+    free(list->paths);
+}
+
+static int compare_paths(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// Читает список путей: по одному в строке, пустые строки пропускаются
+static bool collect_list_file(const char* filename, PathList* list, char** error) {
+    FILE* file = fopen(filename, "r");
+    if (!file) {
+        if (error) *error = "Cannot open input list";
+        return false;
+    }
+
+    char line[4096];
+    bool done = true;
+    while (done && fgets(line, sizeof(line), file)) {
+        size_t length = strlen(line);
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+            length--;
+        }
+        if (length > 0 && !path_list_add(list, line, length)) {
+            if (error) *error = "Memory allocation failed";
+            done = false;
+        }
+    }
+
+    fclose(file);
+    return done;
+}
+
+#ifndef _WIN32
+
+static bool has_bmp_extension(const char* name) {
+    size_t length = strlen(name);
+    if (length < 4) {
+        return false;
+    }
+
+    const char* extension = name + length - 4;
+    return extension[0] == '.' && tolower((unsigned char)extension[1]) == 'b' &&
+           tolower((unsigned char)extension[2]) == 'm' && tolower((unsigned char)extension[3]) == 'p';
+}
+
+// Собирает файлы *.bmp каталога в порядке имен
+static bool collect_directory(const char* directory, PathList* list, char** error) {
+    DIR* dir = opendir(directory);
+    if (!dir) {
+        if (error) *error = "Cannot open input directory";
+        return false;
+    }
+
+    size_t directory_length = strlen(directory);
+    bool separator = directory_length > 0 && directory[directory_length - 1] != '/';
+    bool done = true;
+
+    struct dirent* entry;
+    while (done && (entry = readdir(dir)) != NULL) {
+        if (!has_bmp_extension(entry->d_name)) {
+            continue;
+        }
+
+        char path[4096];
+        int length = snprintf(path, sizeof(path), "%s%s%s", directory, separator ? "/" : "", entry->d_name);
+        if (length < 0 || (size_t)length >= sizeof(path) || !path_list_add(list, path, (size_t)length)) {
+            if (error) *error = "Memory allocation failed";
+            done = false;
+        }
+    }
+
+    closedir(dir);
+    if (done) {
+        qsort(list->paths, list->count, sizeof(char*), compare_paths);
+    }
+    return done;
+}
+
+static bool collect_glob(const char* pattern, PathList* list, char** error) {
+    glob_t matches;
+    int result = glob(pattern, 0, NULL, &matches);
+    if (result == GLOB_NOMATCH) {
+        return true;
+    }
+    if (result != 0) {
+        if (error) *error = "Cannot expand input pattern";
+        return false;
+    }
+
+    bool done = true;
+    for (size_t i = 0; i < matches.gl_pathc && done; i++) {
+        if (!path_list_add(list, matches.gl_pathv[i], strlen(matches.gl_pathv[i]))) {
+            if (error) *error = "Memory allocation failed";
+            done = false;
+        }
+    }
+
+    globfree(&matches);
+    return done;
+}
+
+#endif
+
+static bool collect_inputs(const char* source, PathList* list, char** error) {
+    if (source[0] == '@') {
+        return collect_list_file(source + 1, list, error);
+    }
+
+#ifndef _WIN32
+    struct stat info;
+    if (stat(source, &info) == 0 && S_ISDIR(info.st_mode)) {
+        return collect_directory(source, list, error);
+    }
+    return collect_glob(source, list, error);
+#else
+    if (error) *error = "Only input lists (@file) are supported on this platform";
+    return false;
+#endif
+}
+
+// Строит имя выходного файла для input по шаблону; результат освобождается вызывающим
+static char* output_path(const char* pattern, const char* input) {
+    const char* name = input;
+    for (const char* p = input; *p; p++) {
+        if (*p == '/' || *p == '\\') {
+            name = p + 1;
+        }
+    }
+
+    const char* star = strchr(pattern, '*');
+    size_t pattern_length = strlen(pattern);
+    size_t name_length = strlen(name);
+    char* path = (char*)malloc(pattern_length + name_length + 2);
+    if (!path) {
+        return NULL;
+    }
+
+    if (star) {
+        // Имя без расширения подставляется вместо '*'
+        const char* dot = strrchr(name, '.');
+        size_t stem_length = dot && dot != name ? (size_t)(dot - name) : name_length;
+        size_t prefix_length = (size_t)(star - pattern);
+
+        memcpy(path, pattern, prefix_length);
+        memcpy(path + prefix_length, name, stem_length);
+        strcpy(path + prefix_length + stem_length, star + 1);
+    }
+    else {
+        bool separator = pattern_length > 0 && pattern[pattern_length - 1] != '/' &&
+                         pattern[pattern_length - 1] != '\\';
+        sprintf(path, "%s%s%s", pattern, separator ? "/" : "", name);
+    }
+
+    return path;
+}
+
+static bool process_file(const BatchTask* task, const char* input, const char* output,
+                         int* failed_step, char** error) {
+    if (file_is_same(input, output)) {
+        if (error) *error = "Output file would overwrite the input";
+        return false;
+    }
+
+    if (task->stream_mode) {
+        return stream_process(input, output, task->steps, task->step_count, task->layout, error);
+    }
+
+    Image* img = bmp_load_layout(input, task->layout, error);
+    if (!img) {
+        return false;
+    }
+
+    bool done = pipeline_apply(img, task->steps, task->step_count, false, NULL, failed_step, error) &&
+                bmp_save(output, img, error);
+    image_destroy(img);
+    return done;
+}
+
+static void report_failure(const BatchTask* task, const char* input, int failed_step, const char* error) {
+    if (failed_step >= 0) {
+        fprintf(stderr, "Error processing %s: filter %s: %s\n", input,
+                task->steps[failed_step].filter->name, error);
+    }
+    else {
+        fprintf(stderr, "Error processing %s: %s\n", input, error);
+    }
+}
+
+static void batch_items(void* context, int begin, int end) {
+    BatchTask* task = (BatchTask*)context;
+
+    for (int i = begin; i < end; i++) {
+        const char* input = task->inputs->paths[i];
+        char* output = output_path(task->output_pattern, input);
+        char* error = "Memory allocation failed";
+        int failed_step = -1;
+
+        if (!output || !process_file(task, input, output, &failed_step, &error)) {
+            task->failed[i] = true;
+            report_failure(task, input, failed_step, error);
+        }
+
+        free(output);
+    }
+}
+
+#ifndef _WIN32
+
+// Изображение между стадиями конвейера
+typedef struct {
+    int index;
+    Image* img;
+    char* output;
+} BatchItem;
+
+// Ограниченная очередь между стадиями: push ждет места, pop ждет элемента
+// и возвращает false, когда очередь закрыта и пуста
+typedef struct {
+    BatchItem* items;
+    int capacity;
+    int head;
+    int count;
+    bool closed;
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} BatchQueue;
+
+static bool queue_init(BatchQueue* queue, int capacity) {
+    queue->items = (BatchItem*)malloc(capacity * sizeof(BatchItem));
+    if (!queue->items) {
+        return false;
+    }
+
+    queue->capacity = capacity;
+    queue->head = 0;
+    queue->count = 0;
+    queue->closed = false;
+    pthread_mutex_init(&queue->mutex, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+    return true;
+}
+
+static void queue_destroy(BatchQueue* queue) {
+    pthread_mutex_destroy(&queue->mutex);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+    free(queue->items);
+}
+
+static void queue_push(BatchQueue* queue, BatchItem item) {
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->count == queue->capacity) {
+        pthread_cond_wait(&queue->not_full, &queue->mutex);
+    }
+
+    queue->items[(queue->head + queue->count) % queue->capacity] = item;
+    queue->count++;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+static bool queue_pop(BatchQueue* queue, BatchItem* item) {
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->count == 0 && !queue->closed) {
+        pthread_cond_wait(&queue->not_empty, &queue->mutex);
+    }
+
+    bool found = queue->count > 0;
+    if (found) {
+        *item = queue->items[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+        pthread_cond_signal(&queue->not_full);
+    }
+    pthread_mutex_unlock(&queue->mutex);
+    return found;
+}
+
+static void queue_close(BatchQueue* queue) {
+    pthread_mutex_lock(&queue->mutex);
+    queue->closed = true;
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+// Общее состояние конвейера
+typedef struct {
+    BatchTask* task;
+    BatchQueue loaded;  // Загрузка -> фильтры
+    BatchQueue saving;  // Фильтры -> сохранение
+    pthread_mutex_t mutex;
+    int next_input;
+    int active_loaders;
+} BatchPipeline;
+
+static void* loader_main(void* arg) {
+    BatchPipeline* pipeline = (BatchPipeline*)arg;
+    BatchTask* task = pipeline->task;
+    parallel_set_thread_serial(true);
+
+    for (;;) {
+        pthread_mutex_lock(&pipeline->mutex);
+        int i = pipeline->next_input++;
+        pthread_mutex_unlock(&pipeline->mutex);
+        if (i >= task->inputs->count) {
+            break;
+        }
+
+        const char* input = task->inputs->paths[i];
+        char* error = "Memory allocation failed";
+        BatchItem item = { i, NULL, output_path(task->output_pattern, input) };
+        if (item.output && file_is_same(input, item.output)) {
+            error = "Output file would overwrite the input";
+        }
+        else if (item.output) {
+            item.img = bmp_load_layout(input, task->layout, &error);
+        }
+
+        if (!item.img) {
+            task->failed[i] = true;
+            report_failure(task, input, -1, error);
+            free(item.output);
+            continue;
+        }
+        queue_push(&pipeline->loaded, item);
+    }
+
+    // Последний завершившийся поток загрузки закрывает очередь
+    pthread_mutex_lock(&pipeline->mutex);
+    bool last = --pipeline->active_loaders == 0;
+    pthread_mutex_unlock(&pipeline->mutex);
+    if (last) {
+        queue_close(&pipeline->loaded);
+    }
+    return NULL;
+}
+
+static void* saver_main(void* arg) {
+    BatchPipeline* pipeline = (BatchPipeline*)arg;
+    BatchTask* task = pipeline->task;
+    parallel_set_thread_serial(true);
+
+    BatchItem item;
+    while (queue_pop(&pipeline->saving, &item)) {
+        char* error = NULL;
+        if (!bmp_save(item.output, item.img, &error)) {
+            task->failed[item.index] = true;
+            report_failure(task, task->inputs->paths[item.index], -1, error);
+        }
+        image_destroy(item.img);
+        free(item.output);
+    }
+    return NULL;
+}
+
+// Конвейер: фильтры выполняются в вызывающем потоке с полным пулом, загрузка
+// и сохранение - в своих потоках без пула
+static bool run_pipeline(BatchTask* task, int queue_depth, char** error) {
+    BatchPipeline pipeline;
+    pipeline.task = task;
+    pipeline.next_input = 0;
+    pipeline.active_loaders = BATCH_IO_THREADS;
+    if (!queue_init(&pipeline.loaded, queue_depth)) {
+        if (error) *error = "Memory allocation failed";
+        return false;
+    }
+    if (!queue_init(&pipeline.saving, queue_depth)) {
+        queue_destroy(&pipeline.loaded);
+        if (error) *error = "Memory allocation failed";
+        return false;
+    }
+    pthread_mutex_init(&pipeline.mutex, NULL);
+
+    // Потоки сохранения ждут первых изображений, поэтому создаются первыми
+    pthread_t savers[BATCH_IO_THREADS];
+    int saver_count = 0;
+    for (int i = 0; i < BATCH_IO_THREADS; i++) {
+        if (pthread_create(&savers[saver_count], NULL, saver_main, &pipeline) == 0) saver_count++;
+    }
+
+    pthread_t loaders[BATCH_IO_THREADS];
+    int loader_count = 0;
+    for (int i = 0; i < BATCH_IO_THREADS && saver_count > 0; i++) {
+        if (pthread_create(&loaders[loader_count], NULL, loader_main, &pipeline) == 0) loader_count++;
+    }
+
+    // Не созданные потоки загрузки не закроют очередь сами
+    pthread_mutex_lock(&pipeline.mutex);
+    pipeline.active_loaders -= BATCH_IO_THREADS - loader_count;
+    bool all_loaded = pipeline.active_loaders == 0;
+    pthread_mutex_unlock(&pipeline.mutex);
+    if (all_loaded) {
+        queue_close(&pipeline.loaded);
+    }
+
+    BatchItem item;
+    while (queue_pop(&pipeline.loaded, &item)) {
+        char* failure = NULL;
+        int failed_step = -1;
+        if (!pipeline_apply(item.img, task->steps, task->step_count, false, NULL, &failed_step, &failure)) {
+            task->failed[item.index] = true;
+            report_failure(task, task->inputs->paths[item.index], failed_step, failure);
+            image_destroy(item.img);
+            free(item.output);
+            continue;
+        }
+        queue_push(&pipeline.saving, item);
+    }
+    queue_close(&pipeline.saving);
+
+    for (int i = 0; i < loader_count; i++) {
+        pthread_join(loaders[i], NULL);
+    }
+    for (int i = 0; i < saver_count; i++) {
+        pthread_join(savers[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pipeline.mutex);
+    queue_destroy(&pipeline.loaded);
+    queue_destroy(&pipeline.saving);
+
+    if (loader_count == 0) {
+        if (error) *error = "Cannot start pipeline threads";
+        return false;
+    }
+    return true;
+}
+
+#endif
+
+bool batch_run(const char* source, const char* output_pattern, const FilterStep* steps, int step_count,
+               bool bytes_mode, bool stream_mode, int queue_depth, BatchStats* stats, char** error) {
+    PathList inputs = { NULL, 0, 0 };
+    if (!collect_inputs(source, &inputs, error)) {
+        path_list_free(&inputs);
+        return false;
+    }
+    if (inputs.count == 0) {
+        path_list_free(&inputs);
+        if (error) *error = "No input files found";
+        return false;
+    }
+
+    bool* failed = (bool*)calloc(inputs.count, sizeof(bool));
+    if (!failed) {
+        path_list_free(&inputs);
+        if (error) *error = "Memory allocation failed";
+        return false;
+    }
+
+    BatchTask task;
+    task.inputs = &inputs;
+    task.output_pattern = output_pattern;
+    task.steps = steps;
+    task.step_count = step_count;
+    task.layout = pipeline_layout(steps, step_count, bytes_mode);
+    task.stream_mode = stream_mode;
+    task.failed = failed;
+
+    // Изображения обрабатываются параллельно друг другу, а строки каждого -
+    // в его потоке: для пропускной способности это выгоднее. В конвейере
+    // изображения фильтруются по одному всем пулом, пока идет ввод-вывод
+    double start = profile_wall_ms();
+#ifndef _WIN32
+    if (queue_depth > 0 && !stream_mode) {
+        if (!run_pipeline(&task, queue_depth, error)) {
+            free(failed);
+            path_list_free(&inputs);
+            return false;
+        }
+    }
+    else
+#endif
+    parallel_for_each(inputs.count, batch_items, &task);
+
+    stats->total = inputs.count;
+    stats->failed = 0;
+    stats->seconds = (profile_wall_ms() - start) / 1e3;
+    for (int i = 0; i < inputs.count; i++) {
+        if (failed[i]) stats->failed++;
+    }
+
+    free(failed);
+    path_list_free(&inputs);
+    return true;
+}
@@ -0,0 +1,35 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "filters.h"
+
+// Пакетная обработка: одна цепочка фильтров применяется ко многим файлам.
+// Изображения раздаются рабочим потокам пула по одному, каждое обрабатывается
+// целиком в одном потоке. Ошибка в одном файле печатается и не прерывает пакет.
+//
+// С queue_depth > 0 пакет идет конвейером из трех стадий: потоки загрузки,
+// фильтры (каждое изображение получает весь пул) и потоки сохранения. Стадии
+// связаны очередями не более чем на queue_depth изображений, поэтому чтение
+// и запись следующих и предыдущих файлов идут во время фильтрации, а память
+// ограничена (примерно 2 * queue_depth + 2 * BATCH_IO_THREADS + 1 изображений)
+
+// Источник входных файлов:
+//   @list.txt  - файл со списком путей, по одному в строке
+//   каталог    - все файлы *.bmp каталога
+//   шаблон     - шаблон имен (например, "in/*.bmp")
+// Шаблон выходных файлов: '*' заменяется именем входного файла без расширения
+// ("out/*_gs.bmp"); без '*' шаблон считается каталогом для файлов с теми же именами
+
+// Число потоков загрузки и число потоков сохранения в режиме конвейера
+#define BATCH_IO_THREADS 2
+
+typedef struct {
+    int total;       // Найдено входных файлов
+    int failed;      // Из них не обработано
+    double seconds;  // Время обработки пакета
+} BatchStats;
+
+bool batch_run(const char* source, const char* output_pattern, const FilterStep* steps, int step_count,
+               bool bytes_mode, bool stream_mode, int queue_depth, BatchStats* stats, char** error);
+
+#endif // BATCH_H
@@ -0,0 +1,441 @@
+// Микробенчмарк фильтров: отдельная программа, которая создает синтетические
+// изображения нескольких размеров, замеряет каждый фильтр из available_filters,
+// bmp_load и bmp_save и выводит результаты в JSON.
+//
+// Использование:
+//   bench [-sizes 1,12,50] [-runs N] [-warmup N] [-filters gs,blur,...]
+//         [-8bit] [-threads N] [-dir path] [-o results.json]
+
+#include "image.h"
+#include "filters.h"
+#include "custom_filters.h"
+#include "pipeline.h"
+#include "parallel.h"
+#include "simd.h"
+#include "rng.h"
+#include "profile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define BENCH_MAX_SIZES 16
+#define BENCH_MAX_RUNS 1000
+
+// Аргументы фильтров для замера; у фильтра может быть несколько записей, чтобы
+// замерить разные реализации (сети и гистограммы медианы, свертку и рекурсивное
+// размытие). Фильтры без записи запускаются без аргументов, crop получает
+// половину ширины и высоты
+typedef struct {
+    const char* name;
+    const char* args;
+} BenchArgs;
+
+static const BenchArgs bench_args[] = {
+    {"edge", "0.2"},
+    {"med", "5"},
+    {"med", "15"},
+    {"blur", "2"},
+    {"blur", "8"}
+};
+
+#define BENCH_ARGS_COUNT (int)(sizeof(bench_args) / sizeof(bench_args[0]))
+
+// Индекс следующей записи bench_args для фильтра начиная с from; -1 - записей больше нет
+static int next_bench_args(const char* name, int from) {
+    for (int k = from; k < BENCH_ARGS_COUNT; k++) {
+        if (strcmp(bench_args[k].name, name) == 0) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+typedef struct {
+    double sizes[BENCH_MAX_SIZES];  // Размеры в мегапикселях
+    int size_count;
+    int runs;
+    int warmup;
+    const char* filters;  // Список через запятую или NULL - все фильтры
+    bool bytes_mode;
+    const char* directory;  // Каталог для временного BMP
+    const char* output;     // Файл JSON или NULL - stdout
+} BenchOptions;
+
+// Результат замера одной операции на одном размере
+typedef struct {
+    double times[BENCH_MAX_RUNS];  // Миллисекунды
+    int count;
+    long peak_rss_kb;
+} BenchResult;
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Процентиль по ближайшему рангу в отсортированном массиве
+static double percentile(const double* sorted, int count, double p) {
+    int rank = (int)ceil(p * count);
+    return sorted[(rank > 0 ? rank : 1) - 1];
+}
+
+// Синтетическое изображение: плавные градиенты, прямоугольники с резкими краями
+// и шум, чтобы фильтры с ветвлениями (медиана, края) работали как на фотографиях.
+// Пиксели хранятся строками BMP (b, g, r) без выравнивания
+static uint8_t* synthetic_create(int width, int height) {
+    uint8_t* pixels = (uint8_t*)malloc((size_t)width * height * 3);
+    if (!pixels) {
+        return NULL;
+    }
+
+    for (int y = 0; y < height; y++) {
+        uint8_t* row = pixels + (size_t)y * width * 3;
+        for (int x = 0; x < width; x++) {
+            uint64_t noise = rng_hash(2024, (uint64_t)y * width + x);
+            bool block = ((x / 97) + (y / 61)) % 5 == 0;
+            int base[3] = {
+                x * 255 / width,
+                y * 255 / height,
+                block ? 230 : 64
+            };
+
+            for (int channel = 0; channel < 3; channel++) {
+                int value = base[channel] + (int)((noise >> (channel * 8)) & 31) - 16;
+                row[x * 3 + channel] = (uint8_t)(value < 0 ? 0 : value > 255 ? 255 : value);
+            }
+        }
+    }
+    return pixels;
+}
+
+static Image* synthetic_image(const uint8_t* pixels, int width, int height, ImageLayout layout) {
+    Image* img = image_create_layout(width, height, layout);
+    if (!img) {
+        return NULL;
+    }
+
+    for (int y = 0; y < height; y++) {
+        bmp_decode_row(img, y, pixels + (size_t)y * width * 3);
+    }
+    return img;
+}
+
+static bool filter_selected(const BenchOptions* options, const char* name) {
+    if (!options->filters) {
+        return true;
+    }
+
+    size_t length = strlen(name);
+    for (const char* p = options->filters; *p; ) {
+        const char* end = strchr(p, ',');
+        size_t item = end ? (size_t)(end - p) : strlen(p);
+        if (item == length && strncmp(p, name, length) == 0) {
+            return true;
+        }
+        p += item + (end ? 1 : 0);
+    }
+    return false;
+}
+
+static void print_json_header(FILE* out, const BenchOptions* options) {
+    fprintf(out, "{\n  \"threads\": %d,\n  \"simd\": \"%s\",\n  \"mode\": \"%s\",\n"
+            "  \"runs\": %d,\n  \"warmup\": %d,\n  \"results\": [",
+            parallel_get_threads(), simd_level_name(simd_level()), options->bytes_mode ? "8bit" : "float",
+            options->runs, options->warmup);
+}
+
+static void print_json_result(FILE* out, bool* first, const char* name, const char* args,
+                              int width, int height, const BenchResult* result, const char* error) {
+    fprintf(out, "%s\n    {\"name\": \"%s\", \"args\": \"%s\", \"width\": %d, \"height\": %d",
+            *first ? "" : ",", name, args, width, height);
+    *first = false;
+
+    if (error) {
+        fprintf(out, ", \"error\": \"%s\"}", error);
+        return;
+    }
+
+    double sorted[BENCH_MAX_RUNS];
+    memcpy(sorted, result->times, result->count * sizeof(double));
+    qsort(sorted, result->count, sizeof(double), compare_doubles);
+
+    double median = percentile(sorted, result->count, 0.5);
+    double megapixels = (double)width * height / 1e6;
+    fprintf(out, ", \"megapixels\": %.3f, \"runs\": %d, \"min_ms\": %.3f, \"median_ms\": %.3f, \"p95_ms\": %.3f, "
+            "\"mpix_per_s\": %.2f, \"peak_rss_kb\": %ld}",
+            megapixels, result->count, sorted[0], median, percentile(sorted, result->count, 0.95),
+            median > 0.0 ? megapixels / (median / 1e3) : 0.0, result->peak_rss_kb);
+}
+
+// Замеряет один фильтр: каждый запуск получает свежую копию изображения
+// в раскладке фильтра, время создания копии не учитывается
+static bool bench_filter(const BenchOptions* options, const uint8_t* pixels, int width, int height,
+                         FilterStep* step, BenchResult* result, char** error) {
+    ImageLayout layout = pipeline_layout(step, 1, options->bytes_mode);
+    result->count = 0;
+    profile_reset_peak_rss();
+
+    for (int run = 0; run < options->warmup + options->runs; run++) {
+        Image* img = synthetic_image(pixels, width, height, layout);
+        if (!img) {
+            if (error) *error = "Memory allocation failed";
+            return false;
+        }
+
+        int failed_step = -1;
+        double start = profile_wall_ms();
+        bool done = pipeline_apply(img, step, 1, false, NULL, &failed_step, error);
+        double elapsed = profile_wall_ms() - start;
+        image_destroy(img);
+
+        if (!done) {
+            return false;
+        }
+        if (run >= options->warmup) {
+            result->times[result->count++] = elapsed;
+        }
+    }
+
+    result->peak_rss_kb = profile_peak_rss_kb();
+    vignette_cache_clear();
+    return true;
+}
+
+// Замеряет bmp_save и bmp_load на временном файле; повторные чтения идут из кэша ОС
+static bool bench_io(const BenchOptions* options, const uint8_t* pixels, int width, int height,
+                     const char* path, BenchResult* save, BenchResult* load, char** error) {
+    ImageLayout layout = options->bytes_mode ? IMAGE_LAYOUT_BYTES : IMAGE_LAYOUT_INTERLEAVED;
+    Image* img = synthetic_image(pixels, width, height, layout);
+    if (!img) {
+        if (error) *error = "Memory allocation failed";
+        return false;
+    }
+
+    save->count = 0;
+    profile_reset_peak_rss();
+    for (int run = 0; run < options->warmup + options->runs; run++) {
+        double start = profile_wall_ms();
+        bool done = bmp_save(path, img, error);
+        double elapsed = profile_wall_ms() - start;
+        if (!done) {
+            image_destroy(img);
+            return false;
+        }
+        if (run >= options->warmup) {
+            save->times[save->count++] = elapsed;
+        }
+    }
+    save->peak_rss_kb = profile_peak_rss_kb();
+    image_destroy(img);
+
+    load->count = 0;
+    profile_reset_peak_rss();
+    for (int run = 0; run < options->warmup + options->runs; run++) {
+        double start = profile_wall_ms();
+        Image* loaded = bmp_load_layout(path, layout, error);
+        double elapsed = profile_wall_ms() - start;
+        if (!loaded) {
+            return false;
+        }
+        image_destroy(loaded);
+        if (run >= options->warmup) {
+            load->times[load->count++] = elapsed;
+        }
+    }
+    load->peak_rss_kb = profile_peak_rss_kb();
+    return true;
+}
+
+static bool parse_sizes(const char* text, BenchOptions* options) {
+    options->size_count = 0;
+    const char* p = text;
+    while (*p) {
+        char* end = NULL;
+        double size = strtod(p, &end);
+        if (end == p || size <= 0.0 || options->size_count == BENCH_MAX_SIZES) {
+            return false;
+        }
+        options->sizes[options->size_count++] = size;
+
+        p = end;
+        if (*p == ',') {
+            p++;
+        }
+        else if (*p) {
+            return false;
+        }
+    }
+    return options->size_count > 0;
+}
+
+static void print_help(void) {
+    printf("Usage: bench [options]\n");
+    printf("\nOptions:\n");
+    printf("  -sizes list             Image sizes in megapixels (default: 1,12,50)\n");
+    printf("  -runs count             Measured runs per operation (default: 5)\n");
+    printf("  -warmup count           Unmeasured runs before them (default: 1)\n");
+    printf("  -filters list           Only these filters, comma-separated (default: all);\n");
+    printf("                          bmp_load or bmp_save selects the I/O pair\n");
+    printf("  -8bit                   Keep pixels as 8-bit integers\n");
+    printf("  -threads count          Number of worker threads\n");
+    printf("  -dir path               Directory for the temporary BMP (default: .)\n");
+    printf("  -o file                 Write JSON to file instead of stdout\n");
+    printf("\nResults are JSON: median and p95 time, megapixels per second and peak RSS\n");
+    printf("for every filter, bmp_load and bmp_save. Progress goes to stderr.\n");
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options = { {1.0, 12.0, 50.0}, 3, 5, 1, NULL, false, ".", NULL };
+
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "-sizes") == 0 && has_value) {
+            if (!parse_sizes(argv[++i], &options)) {
+                fprintf(stderr, "Invalid size list\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-runs") == 0 && has_value) {
+            options.runs = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-warmup") == 0 && has_value) {
+            options.warmup = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-filters") == 0 && has_value) {
+            options.filters = argv[++i];
+        }
+        else if (strcmp(argv[i], "-threads") == 0 && has_value) {
+            int threads = atoi(argv[++i]);
+            if (threads <= 0) {
+                fprintf(stderr, "Option -threads requires a positive count\n");
+                return 1;
+            }
+            parallel_set_threads(threads);
+        }
+        else if (strcmp(argv[i], "-dir") == 0 && has_value) {
+            options.directory = argv[++i];
+        }
+        else if (strcmp(argv[i], "-o") == 0 && has_value) {
+            options.output = argv[++i];
+        }
+        else if (strcmp(argv[i], "-8bit") == 0) {
+            options.bytes_mode = true;
+        }
+        else {
+            print_help();
+            return strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0 ? 0 : 1;
+        }
+    }
+
+    if (options.runs < 1 || options.runs > BENCH_MAX_RUNS || options.warmup < 0) {
+        fprintf(stderr, "Invalid number of runs\n");
+        return 1;
+    }
+
+    FILE* out = options.output ? fopen(options.output, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Cannot open output file\n");
+        return 1;
+    }
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/bench_%ld.bmp", options.directory, (long)time(NULL));
+
+    BenchResult* result = (BenchResult*)malloc(sizeof(BenchResult));
+    BenchResult* load = (BenchResult*)malloc(sizeof(BenchResult));
+    if (!result || !load) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return 1;
+    }
+
+    print_json_header(out, &options);
+    bool first = true;
+    int failures = 0;
+
+    for (int s = 0; s < options.size_count; s++) {
+        // Соотношение сторон 4:3, как у типичной фотографии
+        int width = (int)lround(sqrt(options.sizes[s] * 1e6 * 4.0 / 3.0));
+        int height = (int)lround(options.sizes[s] * 1e6 / width);
+        if (width < 4 || height < 4) {
+            width = height = 4;
+        }
+
+        fprintf(stderr, "Generating %dx%d image\n", width, height);
+        uint8_t* pixels = synthetic_create(width, height);
+        if (!pixels) {
+            fprintf(stderr, "Memory allocation failed\n");
+            failures++;
+            continue;
+        }
+
+        for (int f = 0; f < filter_count; f++) {
+            Filter* filter = &available_filters[f];
+            if (!filter_selected(&options, filter->name)) {
+                continue;
+            }
+
+            // Без записей фильтр замеряется один раз с пустыми аргументами
+            int entry = next_bench_args(filter->name, 0);
+            do {
+                char args[64] = "";
+                if (entry >= 0) {
+                    snprintf(args, sizeof(args), "%s", bench_args[entry].args);
+                }
+                if (filter->function == filter_crop) {
+                    snprintf(args, sizeof(args), "%d %d %d %d", width / 2, height / 2, width / 4, height / 4);
+                }
+
+                // Аргументы хранятся в копии строки, разбитой пробелами
+                char arg_buffer[64];
+                char* arg_values[4];
+                int arg_count = 0;
+                memcpy(arg_buffer, args, sizeof(arg_buffer));
+                for (char* token = strtok(arg_buffer, " "); token && arg_count < 4; token = strtok(NULL, " ")) {
+                    arg_values[arg_count++] = token;
+                }
+
+                fprintf(stderr, "  %s %s\n", filter->name, args);
+                FilterStep step = { filter, arg_count, arg_values };
+                char* error = NULL;
+                if (!bench_filter(&options, pixels, width, height, &step, result, &error)) {
+                    failures++;
+                    if (!error) error = "Filter failed";
+                }
+                else {
+                    error = NULL;
+                }
+                print_json_result(out, &first, filter->name, args, width, height, result, error);
+                entry = entry >= 0 ? next_bench_args(filter->name, entry + 1) : -1;
+            } while (entry >= 0);
+        }
+
+        if (filter_selected(&options, "bmp_save") || filter_selected(&options, "bmp_load")) {
+            fprintf(stderr, "  bmp_save, bmp_load\n");
+            char* error = NULL;
+            bool done = bench_io(&options, pixels, width, height, path, result, load, &error);
+            if (!done) {
+                failures++;
+            }
+            print_json_result(out, &first, "bmp_save", "", width, height, result, done ? NULL : error);
+            print_json_result(out, &first, "bmp_load", "", width, height, load, done ? NULL : error);
+            remove(path);
+        }
+
+        free(pixels);
+        fflush(out);
+    }
+
+    fprintf(out, "\n  ]\n}\n");
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    free(result);
+    free(load);
+    vignette_cache_clear();
+    parallel_shutdown();
+    return failures > 0 ? 1 : 0;
+}
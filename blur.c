@@ -0,0 +1,321 @@
+#include "blur.h"
+#include "parallel.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Ширина полосы столбцов для вертикального прохода
+#define COLUMN_BLOCK 64
+
+// Длина продолжения сигнала при расчете начальных условий обратного прохода
+#define BOUNDARY_EXTENSION(sigma) ((int)(10.0f * (sigma)) + 64)
+
+// Коэффициенты рекурсивного фильтра третьего порядка
+typedef struct {
+    float b;   // вес входного значения (B)
+    float a1;  // веса предыдущих выходов (b1 / b0, b2 / b0, b3 / b0)
+    float a2;
+    float a3;
+    // Начальные условия обратного прохода по отклонениям последних трех
+    // значений прямого прохода от крайнего пикселя (Triggs, Sdika)
+    float boundary[3][3];
+} RecursiveCoefficients;
+
+typedef struct {
+    Image* img;
+    RecursiveCoefficients coefficients;
+    float** rows;            // Строки float-изображения
+    uint16_t* intermediate;  // Результат горизонтального прохода для IMAGE_LAYOUT_BYTES
+    bool failed;
+} RecursiveBlurTask;
+
+// Масштаб промежуточного значения 8-битного изображения: 255 с 8 дробными битами
+#define INTERMEDIATE_SCALE 65280.0f
+
+// Коэффициенты по статье Young, van Vliet (1995)
+static RecursiveCoefficients recursive_coefficients(float sigma) {
+    double q;
+    if (sigma >= 2.5f) {
+        q = 0.98711 * sigma - 0.96330;
+    }
+    else {
+        q = 3.97156 - 4.14554 * sqrt(1.0 - 0.26891 * sigma);
+    }
+
+    double q2 = q * q;
+    double q3 = q2 * q;
+    double b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+    double b1 = 2.44413 * q + 2.85619 * q2 + 1.26661 * q3;
+    double b2 = -(1.4281 * q2 + 1.26661 * q3);
+    double b3 = 0.422205 * q3;
+
+    RecursiveCoefficients coefficients;
+    double b = 1.0 - (b1 + b2 + b3) / b0;
+    double a[3] = { b1 / b0, b2 / b0, b3 / b0 };
+    coefficients.b = (float)b;
+    coefficients.a1 = (float)a[0];
+    coefficients.a2 = (float)a[1];
+    coefficients.a3 = (float)a[2];
+
+    // Сигнал за правой границей продолжается крайним значением, поэтому
+    // начальные условия линейно зависят от отклонений состояния прямого
+    // прохода от него. Столбцы матрицы находим, продолжая фильтр на нулевом входе
+    int length = BOUNDARY_EXTENSION(sigma);
+    double* forward = (double*)image_temp_alloc(length * sizeof(double));
+    for (int k = 0; k < 3; k++) {
+        double state[3] = { 0.0, 0.0, 0.0 };
+        state[k] = 1.0;
+
+        double result[3] = { 0.0, 0.0, 0.0 };
+        if (forward) {
+            for (int i = 0; i < length; i++) {
+                double w = a[0] * state[0] + a[1] * state[1] + a[2] * state[2];
+                forward[i] = w;
+                state[2] = state[1];
+                state[1] = state[0];
+                state[0] = w;
+            }
+
+            double previous[3] = { 0.0, 0.0, 0.0 };
+            for (int i = length - 1; i >= 0; i--) {
+                double o = b * forward[i] + a[0] * previous[0] + a[1] * previous[1] + a[2] * previous[2];
+                previous[2] = previous[1];
+                previous[1] = previous[0];
+                previous[0] = o;
+            }
+            memcpy(result, previous, sizeof(result));
+        }
+
+        for (int row = 0; row < 3; row++) {
+            coefficients.boundary[row][k] = (float)result[row];
+        }
+    }
+    free(forward);
+
+    return coefficients;
+}
+
+// Начальные значения обратного прохода по трем последним значениям
+// прямого прохода (w1 - последнее) и исходному крайнему значению edge
+static void boundary_values(const RecursiveCoefficients* c, float edge, float w1, float w2, float w3,
+                            float* o1, float* o2, float* o3) {
+    float d1 = w1 - edge;
+    float d2 = w2 - edge;
+    float d3 = w3 - edge;
+    *o1 = edge + c->boundary[0][0] * d1 + c->boundary[0][1] * d2 + c->boundary[0][2] * d3;
+    *o2 = edge + c->boundary[1][0] * d1 + c->boundary[1][1] * d2 + c->boundary[1][2] * d3;
+    *o3 = edge + c->boundary[2][0] * d1 + c->boundary[2][1] * d2 + c->boundary[2][2] * d3;
+}
+
+// Прямой и обратный проходы вдоль строки из width пикселей; за границей
+// повторяется крайний пиксель
+static void recursive_row(const RecursiveCoefficients* coefficients, float* row, int width) {
+    RecursiveCoefficients c = *coefficients;
+
+    for (int channel = 0; channel < 3; channel++) {
+        float edge = row[(width - 1) * 3 + channel];
+        float w1 = row[channel];
+        float w2 = w1;
+        float w3 = w1;
+        for (int x = 0; x < width; x++) {
+            float w = c.b * row[x * 3 + channel] + c.a1 * w1 + c.a2 * w2 + c.a3 * w3;
+            row[x * 3 + channel] = w;
+            w3 = w2;
+            w2 = w1;
+            w1 = w;
+        }
+
+        float o1, o2, o3;
+        boundary_values(&c, edge, w1, w2, w3, &o1, &o2, &o3);
+        for (int x = width - 1; x >= 0; x--) {
+            float o = c.b * row[x * 3 + channel] + c.a1 * o1 + c.a2 * o2 + c.a3 * o3;
+            row[x * 3 + channel] = o;
+            o3 = o2;
+            o2 = o1;
+            o1 = o;
+        }
+    }
+}
+
+static void recursive_horizontal_rows(void* context, int y_begin, int y_end) {
+    RecursiveBlurTask* task = (RecursiveBlurTask*)context;
+    int width = task->img->width;
+
+    if (!task->intermediate) {
+        for (int y = y_begin; y < y_end; y++) {
+            recursive_row(&task->coefficients, task->rows[y], width);
+        }
+        return;
+    }
+
+    // 8-битная строка переводится в float только на время прохода
+    float* row = (float*)image_temp_alloc((size_t)width * 3 * sizeof(float));
+    if (!row) {
+        task->failed = true;
+        return;
+    }
+
+    for (int y = y_begin; y < y_end; y++) {
+        const uint8_t* bytes = task->img->bytes[y];
+        for (int i = 0; i < width * 3; i++) {
+            row[i] = byte_to_unit[bytes[i]];
+        }
+
+        recursive_row(&task->coefficients, row, width);
+
+        uint16_t* output = task->intermediate + (size_t)y * width * 3;
+        for (int i = 0; i < width * 3; i++) {
+            float value = row[i] < 0.0f ? 0.0f : (row[i] > 1.0f ? 1.0f : row[i]);
+            output[i] = (uint16_t)(value * INTERMEDIATE_SCALE + 0.5f);
+        }
+    }
+
+    free(row);
+}
+
+// Прямой и обратный проходы вдоль столбцов [x_begin, x_end): строки обрабатываются
+// целиком в пределах полосы столбцов, что дает последовательный доступ к памяти
+static void recursive_vertical_block(float* const* rows, int height, const RecursiveCoefficients* coefficients,
+                                     int x_begin, int x_end) {
+    RecursiveCoefficients c = *coefficients;
+    int begin = x_begin * 3;
+    int end = x_end * 3;
+
+    // Исходная нижняя строка нужна для начальных условий обратного прохода
+    float edge[COLUMN_BLOCK * 3];
+    memcpy(edge, rows[height - 1] + begin, (end - begin) * sizeof(float));
+
+    for (int y = 0; y < height; y++) {
+        float* row = rows[y];
+        const float* w1 = rows[y >= 1 ? y - 1 : 0];
+        const float* w2 = rows[y >= 2 ? y - 2 : 0];
+        const float* w3 = rows[y >= 3 ? y - 3 : 0];
+
+        // Над первой строкой фильтр находится в установившемся режиме
+        for (int i = begin; i < end; i++) {
+            float p1 = y >= 1 ? w1[i] : row[i];
+            float p2 = y >= 2 ? w2[i] : p1;
+            float p3 = y >= 3 ? w3[i] : p2;
+            row[i] = c.b * row[i] + c.a1 * p1 + c.a2 * p2 + c.a3 * p3;
+        }
+    }
+
+    // Значения за нижней границей для обратного прохода
+    float boundary[3][COLUMN_BLOCK * 3];
+    const float* w1 = rows[height - 1];
+    const float* w2 = rows[height >= 2 ? height - 2 : 0];
+    const float* w3 = rows[height >= 3 ? height - 3 : 0];
+    for (int i = begin; i < end; i++) {
+        boundary_values(&c, edge[i - begin], w1[i], w2[i], w3[i],
+                        &boundary[0][i - begin], &boundary[1][i - begin], &boundary[2][i - begin]);
+    }
+
+    for (int y = height - 1; y >= 0; y--) {
+        float* row = rows[y];
+        const float* o1 = y + 1 < height ? rows[y + 1] + begin : boundary[0];
+        const float* o2 = y + 2 < height ? rows[y + 2] + begin : boundary[y + 2 - height];
+        const float* o3 = y + 3 < height ? rows[y + 3] + begin : boundary[y + 3 - height];
+
+        for (int i = begin; i < end; i++) {
+            row[i] = c.b * row[i] + c.a1 * o1[i - begin] + c.a2 * o2[i - begin] + c.a3 * o3[i - begin];
+        }
+    }
+
+    // Ограничиваем значения только после обратного прохода, иначе
+    // обрезка попала бы в рекурсию
+    for (int y = 0; y < height; y++) {
+        float* row = rows[y];
+        for (int i = begin; i < end; i++) {
+            row[i] = row[i] < 0.0f ? 0.0f : (row[i] > 1.0f ? 1.0f : row[i]);
+        }
+    }
+}
+
+static void recursive_vertical_columns(void* context, int block_begin, int block_end) {
+    RecursiveBlurTask* task = (RecursiveBlurTask*)context;
+    int width = task->img->width;
+    int height = task->img->height;
+
+    if (!task->intermediate) {
+        for (int block = block_begin; block < block_end; block++) {
+            int x_begin = block * COLUMN_BLOCK;
+            int x_end = x_begin + COLUMN_BLOCK;
+            if (x_end > width) x_end = width;
+
+            recursive_vertical_block(task->rows, height, &task->coefficients, x_begin, x_end);
+        }
+        return;
+    }
+
+    // Для 8-битного изображения полоса столбцов переводится в float целиком
+    float* buffer = (float*)image_temp_alloc((size_t)height * COLUMN_BLOCK * 3 * sizeof(float));
+    float** rows = (float**)image_temp_alloc(height * sizeof(float*));
+    if (!buffer || !rows) {
+        free(buffer);
+        free(rows);
+        task->failed = true;
+        return;
+    }
+
+    for (int y = 0; y < height; y++) {
+        rows[y] = buffer + (size_t)y * COLUMN_BLOCK * 3;
+    }
+
+    for (int block = block_begin; block < block_end; block++) {
+        int x_begin = block * COLUMN_BLOCK;
+        int x_end = x_begin + COLUMN_BLOCK;
+        if (x_end > width) x_end = width;
+        int count = (x_end - x_begin) * 3;
+
+        for (int y = 0; y < height; y++) {
+            const uint16_t* source = task->intermediate + ((size_t)y * width + x_begin) * 3;
+            for (int i = 0; i < count; i++) {
+                rows[y][i] = source[i] / INTERMEDIATE_SCALE;
+            }
+        }
+
+        recursive_vertical_block(rows, height, &task->coefficients, 0, x_end - x_begin);
+
+        for (int y = 0; y < height; y++) {
+            uint8_t* output = task->img->bytes[y] + x_begin * 3;
+            for (int i = 0; i < count; i++) {
+                output[i] = (uint8_t)(rows[y][i] * 255.0f + 0.5f);
+            }
+        }
+    }
+
+    free(buffer);
+    free(rows);
+}
+
+bool blur_recursive(Image* img, float sigma) {
+    RecursiveBlurTask task = { img, recursive_coefficients(sigma), NULL, NULL, false };
+
+    if (img->layout == IMAGE_LAYOUT_BYTES) {
+        task.intermediate = (uint16_t*)image_temp_alloc((size_t)img->width * img->height * 3 * sizeof(uint16_t));
+        if (!task.intermediate) {
+            return false;
+        }
+    }
+    else {
+        task.rows = (float**)image_temp_alloc(img->height * sizeof(float*));
+        if (!task.rows) {
+            return false;
+        }
+        for (int y = 0; y < img->height; y++) {
+            task.rows[y] = (float*)img->data[y];
+        }
+    }
+
+    parallel_for_rows(img->height, recursive_horizontal_rows, &task);
+
+    // Вертикальный проход распределяется по потокам полосами столбцов
+    if (!task.failed) {
+        int blocks = (img->width + COLUMN_BLOCK - 1) / COLUMN_BLOCK;
+        parallel_for_rows(blocks, recursive_vertical_columns, &task);
+    }
+
+    free(task.rows);
+    free(task.intermediate);
+    return !task.failed;
+}
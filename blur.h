@@ -0,0 +1,14 @@
+#ifndef BLUR_H
+#define BLUR_H
+
+#include "image.h"
+
+// Начиная с этой сигмы размытие по умолчанию считается рекурсивным фильтром
+#define BLUR_RECURSIVE_MIN_SIGMA 3.0f
+
+// Рекурсивное (БИХ) Гауссово размытие Янга - ван Влита: число операций
+// на пиксель не зависит от сигмы. Изображение обрабатывается на месте;
+// 8-битное изображение переводится в float построчно и полосами столбцов
+bool blur_recursive(Image* img, float sigma);
+
+#endif // BLUR_H
@@ -1,59 +1,89 @@
-#include "color.h"
-#include <math.h>
-
-Pixel pixel_create(float r, float g, float b) {
-    Pixel p = { r, g, b };
-    return p;
-}
-
-Pixel pixel_from_bytes(uint8_t r, uint8_t g, uint8_t b) {
-    Pixel p = {
-        r / 255.0f,
-        g / 255.0f,
-        b / 255.0f
-    };
-    return p;
-}
-
-void pixel_to_bytes(Pixel p, uint8_t* r, uint8_t* g, uint8_t* b) {
-    //     [0, 1]
-    float red = p.r < 0.0f ? 0.0f : (p.r > 1.0f ? 1.0f : p.r);
-    float green = p.g < 0.0f ? 0.0f : (p.g > 1.0f ? 1.0f : p.g);
-    float blue = p.b < 0.0f ? 0.0f : (p.b > 1.0f ? 1.0f : p.b);
-
-    *r = (uint8_t)(red * 255.0f + 0.5f);
-    *g = (uint8_t)(green * 255.0f + 0.5f);
-    *b = (uint8_t)(blue * 255.0f + 0.5f);
-}
-
-Pixel pixel_add(Pixel a, Pixel b) {
-    Pixel result = {
-        a.r + b.r,
-        a.g + b.g,
-        a.b + b.b
-    };
-    return result;
-}
-
-Pixel pixel_multiply(Pixel p, float scalar) {
-    Pixel result = {
-        p.r * scalar,
-        p.g * scalar,
-        p.b * scalar
-    };
-    return result;
-}
-
-Pixel pixel_multiply_pixel(Pixel a, Pixel b) {
-    Pixel result = {
-        a.r * b.r,
-        a.g * b.g,
-        a.b * b.b
-    };
-    return result;
-}
-
-float pixel_luminance(Pixel p) {
-    //      
-    return 0.299f * p.r + 0.587f * p.g + 0.114f * p.b;
+#include "color.h"
+#include "simd.h"
+#include <math.h>
+
+// Строка Pixel передается векторным ядрам как массив float
+_Static_assert(sizeof(Pixel) == 3 * sizeof(float), "Pixel must be three packed floats");
+
+// Деление выполняется компилятором с тем же округлением, что и во время выполнения
+#define UNIT(v) ((v) / 255.0f)
+#define UNIT4(v) UNIT(v), UNIT((v) + 1), UNIT((v) + 2), UNIT((v) + 3)
+#define UNIT16(v) UNIT4(v), UNIT4((v) + 4), UNIT4((v) + 8), UNIT4((v) + 12)
+#define UNIT64(v) UNIT16(v), UNIT16((v) + 16), UNIT16((v) + 32), UNIT16((v) + 48)
+
+const float byte_to_unit[256] = {
+    UNIT64(0), UNIT64(64), UNIT64(128), UNIT64(192)
+};
+
+Pixel pixel_create(float r, float g, float b) {
+    Pixel p = { r, g, b };
+    return p;
+}
+
+Pixel pixel_from_bytes(uint8_t r, uint8_t g, uint8_t b) {
+    Pixel p = {
+        byte_to_unit[r],
+        byte_to_unit[g],
+        byte_to_unit[b]
+    };
+    return p;
+}
+
+void pixel_to_bytes(Pixel p, uint8_t* r, uint8_t* g, uint8_t* b) {
+    // Ограничиваем значения в диапазоне [0, 1]
+    float red = p.r < 0.0f ? 0.0f : (p.r > 1.0f ? 1.0f : p.r);
+    float green = p.g < 0.0f ? 0.0f : (p.g > 1.0f ? 1.0f : p.g);
+    float blue = p.b < 0.0f ? 0.0f : (p.b > 1.0f ? 1.0f : p.b);
+
+    *r = (uint8_t)(red * 255.0f + 0.5f);
+    *g = (uint8_t)(green * 255.0f + 0.5f);
+    *b = (uint8_t)(blue * 255.0f + 0.5f);
+}
+
+Pixel pixel_add(Pixel a, Pixel b) {
+    Pixel result = {
+        a.r + b.r,
+        a.g + b.g,
+        a.b + b.b
+    };
+    return result;
+}
+
+Pixel pixel_multiply(Pixel p, float scalar) {
+    Pixel result = {
+        p.r * scalar,
+        p.g * scalar,
+        p.b * scalar
+    };
+    return result;
+}
+
+Pixel pixel_multiply_pixel(Pixel a, Pixel b) {
+    Pixel result = {
+        a.r * b.r,
+        a.g * b.g,
+        a.b * b.b
+    };
+    return result;
+}
+
+float pixel_luminance(Pixel p) {
+    // Формула для преобразования в оттенки серого
+    return 0.299f * p.r + 0.587f * p.g + 0.114f * p.b;
+}
+
+void color_bgr_to_pixels(const uint8_t* bgr, Pixel* pixels, int count) {
+    simd_bgr_to_rgb(bgr, (float*)pixels, count);
+}
+
+void color_bgr_to_planes(const uint8_t* bgr, float* r, float* g, float* b, int count) {
+    simd_bgr_to_planes(bgr, r, g, b, count);
+}
+
+void color_pixels_to_bgr(const Pixel* pixels, uint8_t* bgr, int count) {
+    simd_rgb_to_bgr((const float*)pixels, bgr, count);
+}
+
+void color_planes_to_bgr(const float* r, const float* g, const float* b, uint8_t* bgr, int count) {
+    simd_planes_to_bgr(r, g, b, bgr, count);
 }
\ No newline at end of file
@@ -1,23 +1,33 @@
-#ifndef COLOR_H
-#define COLOR_H
-
-#include <stdint.h>
-#include <stdbool.h>
-
-//     
-typedef struct {
-    float r;  //   (0.0 - 1.0)
-    float g;  //   (0.0 - 1.0)
-    float b;  //   (0.0 - 1.0)
-} Pixel;
-
-//     
-Pixel pixel_create(float r, float g, float b);
-Pixel pixel_from_bytes(uint8_t r, uint8_t g, uint8_t b);
-void pixel_to_bytes(Pixel p, uint8_t* r, uint8_t* g, uint8_t* b);
-Pixel pixel_add(Pixel a, Pixel b);
-Pixel pixel_multiply(Pixel p, float scalar);
-Pixel pixel_multiply_pixel(Pixel a, Pixel b);
-float pixel_luminance(Pixel p);
-
+#ifndef COLOR_H
+#define COLOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Структура для представления цвета пикселя
+typedef struct {
+    float r;  // Красный компонент (0.0 - 1.0)
+    float g;  // Зеленый компонент (0.0 - 1.0)
+    float b;  // Синий компонент (0.0 - 1.0)
+} Pixel;
+
+// Функции для работы с цветом
+Pixel pixel_create(float r, float g, float b);
+Pixel pixel_from_bytes(uint8_t r, uint8_t g, uint8_t b);
+void pixel_to_bytes(Pixel p, uint8_t* r, uint8_t* g, uint8_t* b);
+Pixel pixel_add(Pixel a, Pixel b);
+Pixel pixel_multiply(Pixel p, float scalar);
+Pixel pixel_multiply_pixel(Pixel a, Pixel b);
+float pixel_luminance(Pixel p);
+
+// Таблица перевода байта в значение канала: byte_to_unit[v] == v / 255.0f
+extern const float byte_to_unit[256];
+
+// Построчный перевод между пикселями BMP (b, g, r по байту) и float;
+// результат совпадает с pixel_from_bytes и pixel_to_bytes
+void color_bgr_to_pixels(const uint8_t* bgr, Pixel* pixels, int count);
+void color_bgr_to_planes(const uint8_t* bgr, float* r, float* g, float* b, int count);
+void color_pixels_to_bgr(const Pixel* pixels, uint8_t* bgr, int count);
+void color_planes_to_bgr(const float* r, const float* g, const float* b, uint8_t* bgr, int count);
+
 #endif // COLOR_H
\ No newline at end of file
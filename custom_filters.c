@@ -1,261 +1,642 @@
-#ifndef CUSTOM_FILTERS_C
-#define CUSTOM_FILTERS_C
-
-#include "custom_filters.h"
-#include "color.h"
-#include <stdlib.h>
-#include <string.h>
-#include <stdio.h>
-#include <math.h>
-#include <time.h>
-#include <float.h>  //   FLT_MAX
-
-//  ,    filters.c
-Pixel get_pixel_with_padding(Image* img, int x, int y);
-
-//  "" -     
-bool filter_crystallize(Image* img, int argc, char** argv, char** error) {
-    (void)argc;
-    (void)argv;
-
-    if (!img) {
-        if (error) *error = "No image provided";
-        return false;
-    }
-
-    //   ()
-    int num_cells = 50;
-
-    //   
-    srand((unsigned int)time(NULL));
-    int* centers_x = (int*)malloc(num_cells * sizeof(int));
-    int* centers_y = (int*)malloc(num_cells * sizeof(int));
-    Pixel* center_colors = (Pixel*)malloc(num_cells * sizeof(Pixel));
-
-    if (!centers_x || !centers_y || !center_colors) {
-        free(centers_x);
-        free(centers_y);
-        free(center_colors);
-        if (error) *error = "Memory allocation failed";
-        return false;
-    }
-
-    //      
-    for (int i = 0; i < num_cells; i++) {
-        centers_x[i] = rand() % img->width;
-        centers_y[i] = rand() % img->height;
-
-        //      
-        Pixel* pixel_ptr = image_get_pixel(img, centers_x[i], centers_y[i]);
-        if (pixel_ptr) {
-            center_colors[i] = *pixel_ptr;  //   
-        }
-        else {
-            center_colors[i] = pixel_create(0, 0, 0);  //    
-        }
-    }
-
-    //     
-    Image* temp = image_create(img->width, img->height);
-    if (!temp) {
-        free(centers_x);
-        free(centers_y);
-        free(center_colors);
-        if (error) *error = "Cannot create temporary image";
-        return false;
-    }
-
-    //          
-    for (int y = 0; y < img->height; y++) {
-        for (int x = 0; x < img->width; x++) {
-            int closest_center = 0;
-            float min_distance = FLT_MAX;
-
-            //   
-            for (int i = 0; i < num_cells; i++) {
-                int dx = x - centers_x[i];
-                int dy = y - centers_y[i];
-                float distance = sqrtf((float)(dx * dx + dy * dy));
-
-                if (distance < min_distance) {
-                    min_distance = distance;
-                    closest_center = i;
-                }
-            }
-
-            //    
-            image_set_pixel(temp, x, y, center_colors[closest_center]);
-        }
-    }
-
-    //   
-    for (int y = 0; y < img->height; y++) {
-        for (int x = 0; x < img->width; x++) {
-            Pixel* src_pixel = image_get_pixel(temp, x, y);
-            if (src_pixel) {
-                image_set_pixel(img, x, y, *src_pixel);
-            }
-        }
-    }
-
-    //  
-    free(centers_x);
-    free(centers_y);
-    free(center_colors);
-    image_destroy(temp);
-
-    return true;
-}
-
-//  " " -    
-bool filter_glass_distortion(Image* img, int argc, char** argv, char** error) {
-    (void)argc;
-    (void)argv;
-
-    if (!img) {
-        if (error) *error = "No image provided";
-        return false;
-    }
-
-    //  
-    float scale = 0.05f;  //  
-    int distortion = 10;   //  
-
-    srand((unsigned int)time(NULL));
-
-    //     
-    Image* temp = image_create(img->width, img->height);
-    if (!temp) {
-        if (error) *error = "Cannot create temporary image";
-        return false;
-    }
-
-    //    
-    for (int y = 0; y < img->height; y++) {
-        for (int x = 0; x < img->width; x++) {
-            //   
-            float offset_x = sinf((float)x * scale) * (float)distortion;
-            float offset_y = cosf((float)y * scale) * (float)distortion;
-
-            //   
-            offset_x += (float)(rand() % 5 - 2);
-            offset_y += (float)(rand() % 5 - 2);
-
-            //   
-            int new_x = x + (int)offset_x;
-            int new_y = y + (int)offset_y;
-
-            //  
-            if (new_x < 0) new_x = 0;
-            if (new_x >= img->width) new_x = img->width - 1;
-            if (new_y < 0) new_y = 0;
-            if (new_y >= img->height) new_y = img->height - 1;
-
-            //     
-            Pixel pixel = get_pixel_with_padding(img, new_x, new_y);
-            image_set_pixel(temp, x, y, pixel);
-        }
-    }
-
-    //   
-    for (int y = 0; y < img->height; y++) {
-        for (int x = 0; x < img->width; x++) {
-            Pixel* src_pixel = image_get_pixel(temp, x, y);
-            if (src_pixel) {
-                image_set_pixel(img, x, y, *src_pixel);
-            }
-        }
-    }
-
-    image_destroy(temp);
-    return true;
-}
-
-//  "" -      
-bool filter_sepia(Image* img, int argc, char** argv, char** error) {
-    (void)argc;
-    (void)argv;
-
-    if (!img) {
-        if (error) *error = "No image provided";
-        return false;
-    }
-
-    for (int y = 0; y < img->height; y++) {
-        for (int x = 0; x < img->width; x++) {
-            Pixel* pixel = image_get_pixel(img, x, y);
-            if (!pixel) continue;
-
-            //   
-            float r = pixel->r;
-            float g = pixel->g;
-            float b = pixel->b;
-
-            float new_r = r * 0.393f + g * 0.769f + b * 0.189f;
-            float new_g = r * 0.349f + g * 0.686f + b * 0.168f;
-            float new_b = r * 0.272f + g * 0.534f + b * 0.131f;
-
-            //  
-            new_r = new_r > 1.0f ? 1.0f : new_r;
-            new_g = new_g > 1.0f ? 1.0f : new_g;
-            new_b = new_b > 1.0f ? 1.0f : new_b;
-
-            pixel->r = new_r;
-            pixel->g = new_g;
-            pixel->b = new_b;
-        }
-    }
-
-    return true;
-}
-
-//  "" -   
-bool filter_vignette(Image* img, int argc, char** argv, char** error) {
-    (void)argc;
-    (void)argv;
-
-    if (!img) {
-        if (error) *error = "No image provided";
-        return false;
-    }
-
-    //  
-    float center_x = (float)img->width / 2.0f;
-    float center_y = (float)img->height / 2.0f;
-
-    //      
-    float max_distance = sqrtf(center_x * center_x + center_y * center_y);
-
-    //  
-    float strength = 0.7f;
-
-    for (int y = 0; y < img->height; y++) {
-        for (int x = 0; x < img->width; x++) {
-            Pixel* pixel = image_get_pixel(img, x, y);
-            if (!pixel) continue;
-
-            //    
-            float dx = (float)x - center_x;
-            float dy = (float)y - center_y;
-            float distance = sqrtf(dx * dx + dy * dy);
-
-            //    (1.0  ,   )
-            float factor = 1.0f - (distance / max_distance) * strength;
-            if (factor < 0.3f) factor = 0.3f; //  
-
-            //  
-            pixel->r *= factor;
-            pixel->g *= factor;
-            pixel->b *= factor;
-
-            //  
-            if (pixel->r > 1.0f) pixel->r = 1.0f;
-            if (pixel->g > 1.0f) pixel->g = 1.0f;
-            if (pixel->b > 1.0f) pixel->b = 1.0f;
-        }
-    }
-
-    return true;
-}
-
+#ifndef CUSTOM_FILTERS_C
+#define CUSTOM_FILTERS_C
+
+#include "custom_filters.h"
+#include "color.h"
+#include "parallel.h"
+#include "fixed_point.h"
+#include "rng.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+// Число ячеек кристаллизации по умолчанию
+#define CRYSTALLIZE_DEFAULT_CELLS 50
+
+// Центры ячеек, разложенные по равномерной сетке: в клетке сетки в среднем
+// один центр, поэтому поиск ближайшего проверяет только соседние клетки
+typedef struct {
+    int cell_size;       // Сторона клетки сетки в пикселях
+    int grid_width;
+    int grid_height;
+    int* cell_start;     // Начала списков центров клеток, grid_width * grid_height + 1
+    int* cell_centers;   // Номера центров, упорядоченные по клеткам
+} CenterGrid;
+
+// Задание кристаллизации для обработки полосы строк
+typedef struct {
+    Image* src;
+    Image* dst;
+    const int* centers_x;
+    const int* centers_y;
+    const Pixel* center_colors;
+    const CenterGrid* grid;
+} CrystallizeTask;
+
+static bool center_grid_build(CenterGrid* grid, int width, int height,
+                              const int* centers_x, const int* centers_y, int num_cells) {
+    int cell_size = (int)ceil(sqrt((double)width * height / num_cells));
+    if (cell_size < 1) cell_size = 1;
+
+    grid->cell_size = cell_size;
+    grid->grid_width = (width + cell_size - 1) / cell_size;
+    grid->grid_height = (height + cell_size - 1) / cell_size;
+
+    int cell_count = grid->grid_width * grid->grid_height;
+    grid->cell_start = (int*)image_temp_calloc(cell_count + 1, sizeof(int));
+    grid->cell_centers = (int*)image_temp_alloc(num_cells * sizeof(int));
+    if (!grid->cell_start || !grid->cell_centers) {
+        free(grid->cell_start);
+        free(grid->cell_centers);
+        return false;
+    }
+
+    // Сортировка подсчетом: сначала размеры клеток, затем раскладка номеров
+    for (int i = 0; i < num_cells; i++) {
+        int cell = (centers_y[i] / cell_size) * grid->grid_width + centers_x[i] / cell_size;
+        grid->cell_start[cell + 1]++;
+    }
+    for (int cell = 0; cell < cell_count; cell++) {
+        grid->cell_start[cell + 1] += grid->cell_start[cell];
+    }
+    int* fill = (int*)image_temp_alloc(cell_count * sizeof(int));
+    if (!fill) {
+        free(grid->cell_start);
+        free(grid->cell_centers);
+        return false;
+    }
+    memcpy(fill, grid->cell_start, cell_count * sizeof(int));
+    for (int i = 0; i < num_cells; i++) {
+        int cell = (centers_y[i] / cell_size) * grid->grid_width + centers_x[i] / cell_size;
+        grid->cell_centers[fill[cell]++] = i;
+    }
+
+    free(fill);
+    return true;
+}
+
+static void center_grid_free(CenterGrid* grid) {
+    free(grid->cell_start);
+    free(grid->cell_centers);
+}
+
+// Проверяет центры клетки (cell_x, cell_y); при равных расстояниях
+// выбирается центр с меньшим номером
+static inline void closest_in_cell(const CrystallizeTask* task, int cell_x, int cell_y, int x, int y,
+                                   int64_t* best_distance, int* best_center) {
+    const CenterGrid* grid = task->grid;
+    int cell = cell_y * grid->grid_width + cell_x;
+
+    for (int k = grid->cell_start[cell]; k < grid->cell_start[cell + 1]; k++) {
+        int i = grid->cell_centers[k];
+        int64_t dx = x - task->centers_x[i];
+        int64_t dy = y - task->centers_y[i];
+        int64_t distance = dx * dx + dy * dy;  // Квадрат расстояния: корень для сравнения не нужен
+
+        if (distance < *best_distance || (distance == *best_distance && i < *best_center)) {
+            *best_distance = distance;
+            *best_center = i;
+        }
+    }
+}
+
+// Ищет ближайший центр, обходя кольца клеток вокруг клетки пикселя. Пиксели клеток
+// за кольцом r удалены от пикселя больше чем на r * cell_size, поэтому поиск
+// заканчивается, как только найденный центр ближе этой границы
+static int closest_center(const CrystallizeTask* task, int x, int y) {
+    const CenterGrid* grid = task->grid;
+    int cell_x = x / grid->cell_size;
+    int cell_y = y / grid->cell_size;
+    int max_ring = grid->grid_width > grid->grid_height ? grid->grid_width : grid->grid_height;
+
+    int64_t best_distance = INT64_MAX;
+    int best_center = 0;
+
+    for (int ring = 0; ring <= max_ring; ring++) {
+        int top = cell_y - ring;
+        int bottom = cell_y + ring;
+        for (int cy = top; cy <= bottom; cy++) {
+            if (cy < 0 || cy >= grid->grid_height) continue;
+
+            // Внутри кольца проверяются только его края
+            int step = (cy == top || cy == bottom) ? 1 : 2 * ring;
+            for (int cx = cell_x - ring; cx <= cell_x + ring; cx += step) {
+                if (cx < 0 || cx >= grid->grid_width) continue;
+                closest_in_cell(task, cx, cy, x, y, &best_distance, &best_center);
+            }
+        }
+
+        int64_t bound = (int64_t)ring * grid->cell_size + 1;
+        if (best_distance < bound * bound) {
+            break;
+        }
+    }
+
+    return best_center;
+}
+
+static void crystallize_rows(void* context, int y_begin, int y_end) {
+    CrystallizeTask* task = (CrystallizeTask*)context;
+    Image* img = task->src;
+
+    for (int y = y_begin; y < y_end; y++) {
+        Pixel* output = task->dst->data[y];
+        for (int x = 0; x < img->width; x++) {
+            // Используем цвет ближайшего центра
+            output[x] = task->center_colors[closest_center(task, x, y)];
+        }
+    }
+}
+
+// Фильтр "Кристаллизация" - разбивает изображение на ячейки Вороного.
+// Аргументы: число ячеек и зерно генератора центров
+bool filter_crystallize(Image* img, int argc, char** argv, char** error) {
+    int num_cells = argc >= 1 ? atoi(argv[0]) : CRYSTALLIZE_DEFAULT_CELLS;
+    if (num_cells <= 0) {
+        if (error) *error = "Cell count must be positive";
+        return false;
+    }
+    uint64_t seed = argc >= 2 ? strtoull(argv[1], NULL, 10) : 0;
+
+    if (!img) {
+        if (error) *error = "No image provided";
+        return false;
+    }
+
+    if (!image_set_layout(img, IMAGE_LAYOUT_INTERLEAVED)) {
+        if (error) *error = "Cannot convert image layout";
+        return false;
+    }
+
+    // Генерируем случайные центры
+    int* centers_x = (int*)image_temp_alloc(num_cells * sizeof(int));
+    int* centers_y = (int*)image_temp_alloc(num_cells * sizeof(int));
+    Pixel* center_colors = (Pixel*)image_temp_alloc(num_cells * sizeof(Pixel));
+
+    if (!centers_x || !centers_y || !center_colors) {
+        free(centers_x);
+        free(centers_y);
+        free(center_colors);
+        if (error) *error = "Memory allocation failed";
+        return false;
+    }
+
+    // Инициализируем центры случайными позициями и цветами
+    Rng rng;
+    rng_seed(&rng, seed);
+    for (int i = 0; i < num_cells; i++) {
+        centers_x[i] = rng_below(&rng, img->width);
+        centers_y[i] = rng_below(&rng, img->height);
+        center_colors[i] = img->data[centers_y[i]][centers_x[i]];
+    }
+
+    CenterGrid grid;
+    if (!center_grid_build(&grid, img->width, img->height, centers_x, centers_y, num_cells)) {
+        free(centers_x);
+        free(centers_y);
+        free(center_colors);
+        if (error) *error = "Memory allocation failed";
+        return false;
+    }
+
+    // Результат пишется во второй буфер изображения
+    Image* temp = image_scratch(img);
+    if (!temp) {
+        center_grid_free(&grid);
+        free(centers_x);
+        free(centers_y);
+        free(center_colors);
+        if (error) *error = "Cannot create temporary image";
+        return false;
+    }
+
+    // Для каждого пикселя находим ближайший центр и используем его цвет
+    CrystallizeTask task = { img, temp, centers_x, centers_y, center_colors, &grid };
+    parallel_for_rows(img->height, crystallize_rows, &task);
+    image_swap_scratch(img);
+
+    // Освобождаем память
+    center_grid_free(&grid);
+    free(centers_x);
+    free(centers_y);
+    free(center_colors);
+
+    return true;
+}
+
+// Параметры стеклянной дисторсии по умолчанию
+#define GLASS_DEFAULT_SCALE 0.05f
+#define GLASS_DEFAULT_STRENGTH 10.0f
+
+// Задание стеклянной дисторсии для обработки полосы строк
+typedef struct {
+    Image* src;
+    Image* dst;
+    const float* offsets_x;  // Смещение по x для каждого столбца
+    const float* offsets_y;  // Смещение по y для каждой строки
+    uint64_t seed;
+} GlassTask;
+
+static void glass_rows(void* context, int y_begin, int y_end) {
+    GlassTask* task = (GlassTask*)context;
+    Image* img = task->src;
+    int width = img->width;
+    int height = img->height;
+
+    for (int y = y_begin; y < y_end; y++) {
+        Pixel* output = task->dst->data[y];
+        for (int x = 0; x < width; x++) {
+            // Случайная добавка из [-2, 2] зависит только от (x, y) и зерна
+            uint64_t noise = rng_hash(task->seed, (uint64_t)y * width + x);
+            float offset_x = task->offsets_x[x] + (float)((int)((uint32_t)noise % 5) - 2);
+            float offset_y = task->offsets_y[y] + (float)((int)((uint32_t)(noise >> 32) % 5) - 2);
+
+            // Вычисляем новые координаты
+            int new_x = x + (int)offset_x;
+            int new_y = y + (int)offset_y;
+
+            // Ограничиваем координаты
+            if (new_x < 0) new_x = 0;
+            if (new_x >= width) new_x = width - 1;
+            if (new_y < 0) new_y = 0;
+            if (new_y >= height) new_y = height - 1;
+
+            // Берем пиксель из смещенной позиции
+            output[x] = img->data[new_y][new_x];
+        }
+    }
+}
+
+// Фильтр "Стеклянная дисторсия" - искажение как через стекло.
+// Аргументы: масштаб волны, сила искажения в пикселях и зерно шума
+bool filter_glass_distortion(Image* img, int argc, char** argv, char** error) {
+    float scale = argc >= 1 ? (float)atof(argv[0]) : GLASS_DEFAULT_SCALE;
+    float distortion = argc >= 2 ? (float)atof(argv[1]) : GLASS_DEFAULT_STRENGTH;
+    uint64_t seed = argc >= 3 ? strtoull(argv[2], NULL, 10) : 0;
+    if (distortion < 0.0f) {
+        if (error) *error = "Distortion strength must be non-negative";
+        return false;
+    }
+
+    if (!img) {
+        if (error) *error = "No image provided";
+        return false;
+    }
+
+    if (!image_set_layout(img, IMAGE_LAYOUT_INTERLEAVED)) {
+        if (error) *error = "Cannot convert image layout";
+        return false;
+    }
+
+    // Синус зависит только от столбца, косинус - только от строки
+    float* offsets_x = (float*)image_temp_alloc(img->width * sizeof(float));
+    float* offsets_y = (float*)image_temp_alloc(img->height * sizeof(float));
+    if (!offsets_x || !offsets_y) {
+        free(offsets_x);
+        free(offsets_y);
+        if (error) *error = "Memory allocation failed";
+        return false;
+    }
+    for (int x = 0; x < img->width; x++) {
+        offsets_x[x] = sinf((float)x * scale) * distortion;
+    }
+    for (int y = 0; y < img->height; y++) {
+        offsets_y[y] = cosf((float)y * scale) * distortion;
+    }
+
+    // Результат пишется во второй буфер изображения
+    Image* temp = image_scratch(img);
+    if (!temp) {
+        free(offsets_x);
+        free(offsets_y);
+        if (error) *error = "Cannot create temporary image";
+        return false;
+    }
+
+    // Применяем эффект стеклянной дисторсии
+    GlassTask task = { img, temp, offsets_x, offsets_y, seed };
+    parallel_for_rows(img->height, glass_rows, &task);
+    image_swap_scratch(img);
+
+    free(offsets_x);
+    free(offsets_y);
+    return true;
+}
+
+static void sepia_rows(void* context, int y_begin, int y_end) {
+    Image* img = (Image*)context;
+
+    for (int y = y_begin; y < y_end; y++) {
+        for (int x = 0; x < img->width; x++) {
+            Pixel* pixel = image_get_pixel(img, x, y);
+            if (!pixel) continue;
+
+            // Формула для сепии
+            float r = pixel->r;
+            float g = pixel->g;
+            float b = pixel->b;
+
+            float new_r = r * 0.393f + g * 0.769f + b * 0.189f;
+            float new_g = r * 0.349f + g * 0.686f + b * 0.168f;
+            float new_b = r * 0.272f + g * 0.534f + b * 0.131f;
+
+            // Ограничиваем значения
+            new_r = new_r > 1.0f ? 1.0f : new_r;
+            new_g = new_g > 1.0f ? 1.0f : new_g;
+            new_b = new_b > 1.0f ? 1.0f : new_b;
+
+            pixel->r = new_r;
+            pixel->g = new_g;
+            pixel->b = new_b;
+        }
+    }
+}
+
+// Фильтр "Сепия" - коричневый оттенок как на старых фотографиях
+bool filter_sepia(Image* img, int argc, char** argv, char** error) {
+    (void)argc;
+    (void)argv;
+
+    if (!img) {
+        if (error) *error = "No image provided";
+        return false;
+    }
+
+    if (img->layout == IMAGE_LAYOUT_BYTES) {
+        fixed_sepia(img);
+        return true;
+    }
+
+    if (!image_set_layout(img, IMAGE_LAYOUT_INTERLEAVED)) {
+        if (error) *error = "Cannot convert image layout";
+        return false;
+    }
+
+    parallel_for_rows(img->height, sepia_rows, img);
+
+    return true;
+}
+
+// Параметры виньетки по умолчанию
+#define VIGNETTE_DEFAULT_STRENGTH 0.7f
+#define VIGNETTE_DEFAULT_MIN 0.3f
+
+// Число масок в кэше
+#define VIGNETTE_CACHE_SIZE 4
+
+VignetteParams vignette_params(int width, int height, float strength, float min_factor) {
+    VignetteParams params;
+
+    // Центр виньетки
+    params.center_x = (float)width / 2.0f;
+    params.center_y = (float)height / 2.0f;
+
+    // Максимальное расстояние от центра до угла
+    params.max_distance = sqrtf(params.center_x * params.center_x + params.center_y * params.center_y);
+
+    // Сила виньетки и минимальная яркость
+    params.strength = strength;
+    params.min_factor = min_factor;
+
+    return params;
+}
+
+bool vignette_parse_args(int argc, char** argv, float* strength, float* min_factor, char** error) {
+    *strength = argc >= 1 ? (float)atof(argv[0]) : VIGNETTE_DEFAULT_STRENGTH;
+    *min_factor = argc >= 2 ? (float)atof(argv[1]) : VIGNETTE_DEFAULT_MIN;
+
+    if (*strength < 0.0f) {
+        if (error) *error = "Vignette strength must be non-negative";
+        return false;
+    }
+    if (*min_factor < 0.0f || *min_factor > 1.0f) {
+        if (error) *error = "Minimum brightness must be between 0 and 1";
+        return false;
+    }
+    return true;
+}
+
+float vignette_factor(const VignetteParams* params, int x, int y) {
+    // Вычисляем расстояние от центра
+    float dx = (float)x - params->center_x;
+    float dy = (float)y - params->center_y;
+    float distance = sqrtf(dx * dx + dy * dy);
+
+    // Вычисляем коэффициент затемнения (1.0 в центре, меньше на краях)
+    float factor = 1.0f - (distance / params->max_distance) * params->strength;
+    if (factor < params->min_factor) factor = params->min_factor; // Минимальная яркость
+
+    return factor;
+}
+
+static VignetteMask* vignette_cache[VIGNETTE_CACHE_SIZE];
+static int vignette_cache_next = 0;  // Следующий слот для вытеснения
+
+#ifndef _WIN32
+static pthread_mutex_t vignette_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define VIGNETTE_CACHE_LOCK() pthread_mutex_lock(&vignette_cache_mutex)
+#define VIGNETTE_CACHE_UNLOCK() pthread_mutex_unlock(&vignette_cache_mutex)
+#else
+#define VIGNETTE_CACHE_LOCK()
+#define VIGNETTE_CACHE_UNLOCK()
+#endif
+
+// Столбец x находится на расстоянии floor(|x - width / 2|) от центра четверти:
+// левая половина идет к центру, правая - от него
+static inline int quarter_index(int x, int size) {
+    int split = (size + 1) / 2;
+    return x < split ? size / 2 - x : x - split;
+}
+
+static VignetteMask* vignette_mask_create(int width, int height, float strength, float min_factor) {
+    VignetteMask* mask = (VignetteMask*)malloc(sizeof(VignetteMask));
+    if (!mask) {
+        return NULL;
+    }
+
+    mask->params = vignette_params(width, height, strength, min_factor);
+    mask->width = width;
+    mask->height = height;
+    mask->quarter_width = width / 2 + 1;
+    mask->quarter_height = height / 2 + 1;
+    mask->refs = 0;
+    mask->cached = false;
+    mask->factors = (float*)image_temp_alloc((size_t)mask->quarter_width * mask->quarter_height * sizeof(float));
+    if (!mask->factors) {
+        free(mask);
+        return NULL;
+    }
+
+    // Элемент (qx, qy) считается для пикселя левой верхней четверти с теми же |dx| и |dy|
+    for (int qy = 0; qy < mask->quarter_height; qy++) {
+        float* row = mask->factors + (size_t)qy * mask->quarter_width;
+        for (int qx = 0; qx < mask->quarter_width; qx++) {
+            row[qx] = vignette_factor(&mask->params, width / 2 - qx, height / 2 - qy);
+        }
+    }
+
+    return mask;
+}
+
+static void vignette_mask_free(VignetteMask* mask) {
+    if (mask) {
+        free(mask->factors);
+        free(mask);
+    }
+}
+
+const VignetteMask* vignette_mask_acquire(int width, int height, float strength, float min_factor) {
+    VIGNETTE_CACHE_LOCK();
+    for (int i = 0; i < VIGNETTE_CACHE_SIZE; i++) {
+        VignetteMask* mask = vignette_cache[i];
+        if (mask && mask->width == width && mask->height == height &&
+            mask->params.strength == strength && mask->params.min_factor == min_factor) {
+            mask->refs++;
+            VIGNETTE_CACHE_UNLOCK();
+            return mask;
+        }
+    }
+
+    VignetteMask* mask = vignette_mask_create(width, height, strength, min_factor);
+    if (!mask) {
+        VIGNETTE_CACHE_UNLOCK();
+        return NULL;
+    }
+    mask->refs = 1;
+
+    // Маска занимает свободный слот или вытесняет неиспользуемую; если все
+    // маски заняты, новая не кэшируется и освобождается после использования
+    for (int attempt = 0; attempt < VIGNETTE_CACHE_SIZE; attempt++) {
+        int slot = vignette_cache_next;
+        vignette_cache_next = (vignette_cache_next + 1) % VIGNETTE_CACHE_SIZE;
+
+        if (!vignette_cache[slot] || vignette_cache[slot]->refs == 0) {
+            vignette_mask_free(vignette_cache[slot]);
+            vignette_cache[slot] = mask;
+            mask->cached = true;
+            break;
+        }
+    }
+
+    VIGNETTE_CACHE_UNLOCK();
+    return mask;
+}
+
+void vignette_mask_release(const VignetteMask* mask) {
+    if (!mask) {
+        return;
+    }
+
+    VignetteMask* owned = (VignetteMask*)mask;
+    VIGNETTE_CACHE_LOCK();
+    owned->refs--;
+    bool unused = owned->refs == 0 && !owned->cached;
+    VIGNETTE_CACHE_UNLOCK();
+
+    if (unused) {
+        vignette_mask_free(owned);
+    }
+}
+
+void vignette_cache_clear(void) {
+    VIGNETTE_CACHE_LOCK();
+    for (int i = 0; i < VIGNETTE_CACHE_SIZE; i++) {
+        vignette_mask_free(vignette_cache[i]);
+        vignette_cache[i] = NULL;
+    }
+    VIGNETTE_CACHE_UNLOCK();
+}
+
+void vignette_mask_row(const VignetteMask* mask, int y, float* factors) {
+    const float* quarter = mask->factors + (size_t)quarter_index(y, mask->height) * mask->quarter_width;
+    int split = (mask->width + 1) / 2;
+    int center = mask->width / 2;
+
+    for (int x = 0; x < split; x++) {
+        factors[x] = quarter[center - x];
+    }
+    memcpy(factors + split, quarter, (size_t)(mask->width - split) * sizeof(float));
+}
+
+// Задание виньетки для обработки полосы строк
+typedef struct {
+    Image* img;
+    const VignetteMask* mask;
+    bool failed;
+} VignetteTask;
+
+static void vignette_rows(void* context, int y_begin, int y_end) {
+    VignetteTask* task = (VignetteTask*)context;
+    Image* img = task->img;
+    int count = img->width * 3;
+
+    // Коэффициенты строки повторяются для каждого канала, чтобы умножение
+    // шло одним векторизуемым циклом по всем значениям строки
+    float* factors = (float*)image_temp_alloc((size_t)img->width * sizeof(float));
+    float* channel_factors = (float*)image_temp_alloc((size_t)count * sizeof(float));
+    if (!factors || !channel_factors) {
+        free(factors);
+        free(channel_factors);
+        task->failed = true;
+        return;
+    }
+
+    for (int y = y_begin; y < y_end; y++) {
+        vignette_mask_row(task->mask, y, factors);
+        for (int x = 0; x < img->width; x++) {
+            channel_factors[x * 3] = channel_factors[x * 3 + 1] = channel_factors[x * 3 + 2] = factors[x];
+        }
+
+        // Применяем виньетку и ограничиваем значения
+        float* values = (float*)img->data[y];
+        for (int i = 0; i < count; i++) {
+            float value = values[i] * channel_factors[i];
+            values[i] = value > 1.0f ? 1.0f : value;
+        }
+    }
+
+    free(factors);
+    free(channel_factors);
+}
+
+// Фильтр "Виньетка" - затемнение краев изображения.
+// Аргументы: сила затемнения и минимальная яркость на краях
+bool filter_vignette(Image* img, int argc, char** argv, char** error) {
+    float strength;
+    float min_factor;
+    if (!vignette_parse_args(argc, argv, &strength, &min_factor, error)) {
+        return false;
+    }
+
+    if (!img) {
+        if (error) *error = "No image provided";
+        return false;
+    }
+
+    if (!image_set_layout(img, IMAGE_LAYOUT_INTERLEAVED)) {
+        if (error) *error = "Cannot convert image layout";
+        return false;
+    }
+
+    VignetteTask task = { img, vignette_mask_acquire(img->width, img->height, strength, min_factor), false };
+    if (!task.mask) {
+        if (error) *error = "Memory allocation failed";
+        return false;
+    }
+
+    parallel_for_rows(img->height, vignette_rows, &task);
+    vignette_mask_release(task.mask);
+
+    if (task.failed) {
+        if (error) *error = "Memory allocation failed";
+        return false;
+    }
+    return true;
+}
+
 #endif // CUSTOM_FILTERS_C
\ No newline at end of file
@@ -1,12 +1,52 @@
-#ifndef CUSTOM_FILTERS_H
-#define CUSTOM_FILTERS_H
-
-#include "image.h"
-
-//  
-bool filter_crystallize(Image* img, int argc, char** argv, char** error);
-bool filter_glass_distortion(Image* img, int argc, char** argv, char** error);
-bool filter_sepia(Image* img, int argc, char** argv, char** error);
-bool filter_vignette(Image* img, int argc, char** argv, char** error);
-
+#ifndef CUSTOM_FILTERS_H
+#define CUSTOM_FILTERS_H
+
+#include "image.h"
+
+// Дополнительные фильтры
+bool filter_crystallize(Image* img, int argc, char** argv, char** error);
+bool filter_glass_distortion(Image* img, int argc, char** argv, char** error);
+bool filter_sepia(Image* img, int argc, char** argv, char** error);
+bool filter_vignette(Image* img, int argc, char** argv, char** error);
+
+// Параметры виньетки для изображения заданного размера
+typedef struct {
+    float center_x;
+    float center_y;
+    float max_distance;  // Расстояние от центра до угла
+    float strength;
+    float min_factor;    // Минимальная яркость на краях
+} VignetteParams;
+
+VignetteParams vignette_params(int width, int height, float strength, float min_factor);
+
+// Разбирает аргументы виньетки [strength [min]]
+bool vignette_parse_args(int argc, char** argv, float* strength, float* min_factor, char** error);
+
+// Коэффициент затемнения пикселя: 1 в центре, не меньше min_factor на краях
+float vignette_factor(const VignetteParams* params, int x, int y);
+
+// Маска коэффициентов виньетки. Коэффициент зависит только от |x - width / 2|
+// и |y - height / 2|, поэтому хранится одна четверть маски
+typedef struct {
+    VignetteParams params;
+    int width;
+    int height;
+    int quarter_width;
+    int quarter_height;
+    float* factors;  // quarter_height строк по quarter_width коэффициентов
+    int refs;        // Пользователи маски; маски с пользователями не вытесняются из кэша
+    bool cached;
+} VignetteMask;
+
+// Маски для последних размеров и параметров хранятся в кэше процесса, поэтому
+// кадры одного размера не пересчитывают маску. Кэш защищен мьютексом:
+// изображения пакета обрабатываются в нескольких потоках
+const VignetteMask* vignette_mask_acquire(int width, int height, float strength, float min_factor);
+void vignette_mask_release(const VignetteMask* mask);
+void vignette_cache_clear(void);
+
+// Разворачивает строку y маски на всю ширину изображения
+void vignette_mask_row(const VignetteMask* mask, int y, float* factors);
+
 #endif // CUSTOM_FILTERS_H
\ No newline at end of file
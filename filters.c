@@ -1,533 +1,688 @@
-#include "filters.h"
-#include "custom_filters.h"
-#include <stdlib.h>
-#include <string.h>
-#include <stdio.h>
-#include <math.h>
-#include <float.h>
-
-//   
-Filter available_filters[] = {
-    {"crop", filter_crop, 2, 2},
-    {"gs", filter_grayscale, 0, 0},
-    {"neg", filter_negative, 0, 0},
-    {"sharp", filter_sharpening, 0, 0},
-    {"edge", filter_edge_detection, 1, 1},
-    {"med", filter_median, 1, 1},
-    {"blur", filter_gaussian_blur, 1, 1},
-    {"crystallize", filter_crystallize, 0, 0},
-    {"glass", filter_glass_distortion, 0, 0},
-    {"sepia", filter_sepia, 0, 0},
-    {"vignette", filter_vignette, 0, 0}
-};
-
-int filter_count = sizeof(available_filters) / sizeof(available_filters[0]);
-
-//        
-Pixel get_pixel_with_padding(Image* img, int x, int y) {
-    //    
-    int clamped_x = x;
-    if (clamped_x < 0) clamped_x = 0;
-    if (clamped_x >= img->width) clamped_x = img->width - 1;
-
-    int clamped_y = y;
-    if (clamped_y < 0) clamped_y = 0;
-    if (clamped_y >= img->height) clamped_y = img->height - 1;
-
-    return img->data[clamped_y][clamped_x];
-}
-
-//      3x3
-bool apply_matrix_filter(Image* img, float kernel[3][3], char** error) {
-    if (!img) {
-        if (error) *error = "No image provided";
-        return false;
-    }
-
-    //     
-    Image* temp = image_create(img->width, img->height);
-    if (!temp) {
-        if (error) *error = "Cannot create temporary image";
-        return false;
-    }
-
-    //     
-    for (int y = 0; y < img->height; y++) {
-        for (int x = 0; x < img->width; x++) {
-            Pixel sum = { 0, 0, 0 };
-
-            //    3x3
-            for (int ky = -1; ky <= 1; ky++) {
-                for (int kx = -1; kx <= 1; kx++) {
-                    Pixel pixel = get_pixel_with_padding(img, x + kx, y + ky);
-                    float weight = kernel[ky + 1][kx + 1];
-
-                    sum.r += pixel.r * weight;
-                    sum.g += pixel.g * weight;
-                    sum.b += pixel.b * weight;
-                }
-            }
-
-            //  
-            sum.r = sum.r < 0.0f ? 0.0f : (sum.r > 1.0f ? 1.0f : sum.r);
-            sum.g = sum.g < 0.0f ? 0.0f : (sum.g > 1.0f ? 1.0f : sum.g);
-            sum.b = sum.b < 0.0f ? 0.0f : (sum.b > 1.0f ? 1.0f : sum.b);
-
-            image_set_pixel(temp, x, y, sum);
-        }
-    }
-
-    //      
-    for (int y = 0; y < img->height; y++) {
-        for (int x = 0; x < img->width; x++) {
-            Pixel* src_pixel = image_get_pixel(temp, x, y);
-            if (src_pixel) {
-                image_set_pixel(img, x, y, *src_pixel);
-            }
-        }
-    }
-
-    image_destroy(temp);
-    return true;
-}
-
-//     float (  )
-int compare_floats(const void* a, const void* b) {
-    float fa = *(const float*)a;
-    float fb = *(const float*)b;
-
-    if (fa < fb) return -1;
-    if (fa > fb) return 1;
-    return 0;
-}
-
-//   Crop
-bool filter_crop(Image* img, int argc, char** argv, char** error) {
-    if (argc < 2) {
-        if (error) *error = "Crop filter requires width and height parameters";
-        return false;
-    }
-
-    int new_width = atoi(argv[0]);
-    int new_height = atoi(argv[1]);
-
-    if (new_width <= 0 || new_height <= 0) {
-        if (error) *error = "Invalid crop dimensions";
-        return false;
-    }
-
-    //      
-    if (new_width > img->width) new_width = img->width;
-    if (new_height > img->height) new_height = img->height;
-
-    //     
-    Image* cropped = image_create(new_width, new_height);
-    if (!cropped) {
-        if (error) *error = "Cannot create cropped image";
-        return false;
-    }
-
-    //      
-    for (int y = 0; y < new_height; y++) {
-        for (int x = 0; x < new_width; x++) {
-            Pixel* src_pixel = image_get_pixel(img, x, y);
-            if (src_pixel) {
-                image_set_pixel(cropped, x, y, *src_pixel);
-            }
-        }
-    }
-
-    //    
-    //        cropped  img
-    //    
-    if (img->data) {
-        if (img->data[0]) {
-            free(img->data[0]);
-        }
-        free(img->data);
-    }
-
-    //  
-    img->width = cropped->width;
-    img->height = cropped->height;
-
-    //   
-    img->data = (Pixel**)malloc(cropped->height * sizeof(Pixel*));
-    if (!img->data) {
-        image_destroy(cropped);
-        if (error) *error = "Memory allocation failed";
-        return false;
-    }
-
-    Pixel* pixels = (Pixel*)malloc(cropped->width * cropped->height * sizeof(Pixel));
-    if (!pixels) {
-        free(img->data);
-        image_destroy(cropped);
-        if (error) *error = "Memory allocation failed";
-        return false;
-    }
-
-    //  
-    memcpy(pixels, cropped->data[0], cropped->width * cropped->height * sizeof(Pixel));
-
-    //  
-    for (int y = 0; y < cropped->height; y++) {
-        img->data[y] = &pixels[y * cropped->width];
-    }
-
-    //   
-    cropped->data[0] = NULL; //     
-    cropped->data = NULL;
-    image_destroy(cropped);
-
-    return true;
-}
-
-//   Grayscale
-bool filter_grayscale(Image* img, int argc, char** argv, char** error) {
-    (void)argc;
-    (void)argv;
-
-    if (!img) {
-        if (error) *error = "No image provided";
-        return false;
-    }
-
-    for (int y = 0; y < img->height; y++) {
-        for (int x = 0; x < img->width; x++) {
-            Pixel* pixel = image_get_pixel(img, x, y);
-            if (!pixel) continue;
-
-            float luminance = pixel_luminance(*pixel);
-            *pixel = pixel_create(luminance, luminance, luminance);
-        }
-    }
-
-    return true;
-}
-
-//   Negative
-bool filter_negative(Image* img, int argc, char** argv, char** error) {
-    (void)argc;
-    (void)argv;
-
-    if (!img) {
-        if (error) *error = "No image provided";
-        return false;
-    }
-
-    for (int y = 0; y < img->height; y++) {
-        for (int x = 0; x < img->width; x++) {
-            Pixel* pixel = image_get_pixel(img, x, y);
-            if (!pixel) continue;
-
-            pixel->r = 1.0f - pixel->r;
-            pixel->g = 1.0f - pixel->g;
-            pixel->b = 1.0f - pixel->b;
-        }
-    }
-
-    return true;
-}
-
-//   Sharpening
-bool filter_sharpening(Image* img, int argc, char** argv, char** error) {
-    (void)argc;
-    (void)argv;
-
-    if (!img) {
-        if (error) *error = "No image provided";
-        return false;
-    }
-
-    //    
-    float kernel[3][3] = {
-        { 0, -1,  0},
-        {-1,  5, -1},
-        { 0, -1,  0}
-    };
-
-    return apply_matrix_filter(img, kernel, error);
-}
-
-//   Edge Detection
-bool filter_edge_detection(Image* img, int argc, char** argv, char** error) {
-    if (argc < 1) {
-        if (error) *error = "Edge detection requires threshold parameter";
-        return false;
-    }
-
-    float threshold = (float)atof(argv[0]);
-    if (threshold < 0.0f || threshold > 1.0f) {
-        if (error) *error = "Threshold must be between 0 and 1";
-        return false;
-    }
-
-    if (!img) {
-        if (error) *error = "No image provided";
-        return false;
-    }
-
-    //     
-    filter_grayscale(img, 0, NULL, error);
-
-    //     
-    float sobel_x[3][3] = {
-        { 1,  0, -1},
-        { 2,  0, -2},
-        { 1,  0, -1}
-    };
-
-    float sobel_y[3][3] = {
-        { 1,  2,  1},
-        { 0,  0,  0},
-        {-1, -2, -1}
-    };
-
-    //     
-    Image* temp = image_create(img->width, img->height);
-    if (!temp) {
-        if (error) *error = "Cannot create temporary image";
-        return false;
-    }
-
-    //     
-    for (int y = 0; y < img->height; y++) {
-        for (int x = 0; x < img->width; x++) {
-            float grad_x = 0.0f;
-            float grad_y = 0.0f;
-
-            //    
-            for (int ky = -1; ky <= 1; ky++) {
-                for (int kx = -1; kx <= 1; kx++) {
-                    Pixel pixel = get_pixel_with_padding(img, x + kx, y + ky);
-                    float intensity = pixel.r; //     grayscale
-
-                    grad_x += intensity * sobel_x[ky + 1][kx + 1];
-                    grad_y += intensity * sobel_y[ky + 1][kx + 1];
-                }
-            }
-
-            //   
-            float magnitude = sqrtf(grad_x * grad_x + grad_y * grad_y);
-
-            //  
-            Pixel result;
-            if (magnitude > threshold) {
-                result = pixel_create(1.0f, 1.0f, 1.0f); // 
-            }
-            else {
-                result = pixel_create(0.0f, 0.0f, 0.0f); // 
-            }
-
-            image_set_pixel(temp, x, y, result);
-        }
-    }
-
-    //   
-    for (int y = 0; y < img->height; y++) {
-        for (int x = 0; x < img->width; x++) {
-            Pixel* src_pixel = image_get_pixel(temp, x, y);
-            if (src_pixel) {
-                image_set_pixel(img, x, y, *src_pixel);
-            }
-        }
-    }
-
-    image_destroy(temp);
-    return true;
-}
-
-//    ( )
-bool filter_median(Image* img, int argc, char** argv, char** error) {
-    if (argc < 1) {
-        if (error) *error = "Median filter requires window size parameter";
-        return false;
-    }
-
-    int window_size = atoi(argv[0]);
-    if (window_size <= 0 || window_size % 2 == 0) {
-        if (error) *error = "Window size must be positive odd number";
-        return false;
-    }
-
-    if (!img) {
-        if (error) *error = "No image provided";
-        return false;
-    }
-
-    int radius = window_size / 2;
-    int window_area = window_size * window_size;
-
-    //     
-    float* r_values = (float*)malloc(window_area * sizeof(float));
-    float* g_values = (float*)malloc(window_area * sizeof(float));
-    float* b_values = (float*)malloc(window_area * sizeof(float));
-
-    if (!r_values || !g_values || !b_values) {
-        free(r_values);
-        free(g_values);
-        free(b_values);
-        if (error) *error = "Memory allocation failed";
-        return false;
-    }
-
-    //     
-    Image* temp = image_create(img->width, img->height);
-    if (!temp) {
-        free(r_values);
-        free(g_values);
-        free(b_values);
-        if (error) *error = "Cannot create temporary image";
-        return false;
-    }
-
-    //   
-    for (int y = 0; y < img->height; y++) {
-        for (int x = 0; x < img->width; x++) {
-            int count = 0;
-
-            //    
-            for (int wy = -radius; wy <= radius; wy++) {
-                for (int wx = -radius; wx <= radius; wx++) {
-                    Pixel pixel = get_pixel_with_padding(img, x + wx, y + wy);
-
-                    r_values[count] = pixel.r;
-                    g_values[count] = pixel.g;
-                    b_values[count] = pixel.b;
-                    count++;
-                }
-            }
-
-            //    
-            qsort(r_values, count, sizeof(float), compare_floats);
-            qsort(g_values, count, sizeof(float), compare_floats);
-            qsort(b_values, count, sizeof(float), compare_floats);
-
-            //   
-            int median_index = count / 2;
-            Pixel median_pixel = {
-                r_values[median_index],
-                g_values[median_index],
-                b_values[median_index]
-            };
-
-            image_set_pixel(temp, x, y, median_pixel);
-        }
-    }
-
-    //   
-    for (int y = 0; y < img->height; y++) {
-        for (int x = 0; x < img->width; x++) {
-            Pixel* src_pixel = image_get_pixel(temp, x, y);
-            if (src_pixel) {
-                image_set_pixel(img, x, y, *src_pixel);
-            }
-        }
-    }
-
-    //  
-    free(r_values);
-    free(g_values);
-    free(b_values);
-    image_destroy(temp);
-
-    return true;
-}
-
-//   
-bool filter_gaussian_blur(Image* img, int argc, char** argv, char** error) {
-    if (argc < 1) {
-        if (error) *error = "Gaussian blur requires sigma parameter";
-        return false;
-    }
-
-    float sigma = (float)atof(argv[0]);
-    if (sigma <= 0.0f) {
-        if (error) *error = "Sigma must be positive";
-        return false;
-    }
-
-    if (!img) {
-        if (error) *error = "No image provided";
-        return false;
-    }
-
-    //    ( 3?)
-    int radius = (int)ceilf(3 * sigma);
-    int kernel_size = 2 * radius + 1;
-
-    //     
-    float* kernel = (float*)malloc(kernel_size * sizeof(float));
-    if (!kernel) {
-        if (error) *error = "Memory allocation failed";
-        return false;
-    }
-
-    float sum = 0.0f;
-    for (int i = 0; i < kernel_size; i++) {
-        int x = i - radius;
-        kernel[i] = expf(-(x * x) / (2 * sigma * sigma));
-        sum += kernel[i];
-    }
-
-    //  
-    for (int i = 0; i < kernel_size; i++) {
-        kernel[i] /= sum;
-    }
-
-    //      
-    Image* temp = image_create(img->width, img->height);
-    if (!temp) {
-        free(kernel);
-        if (error) *error = "Cannot create temporary image";
-        return false;
-    }
-
-    //    
-    for (int y = 0; y < img->height; y++) {
-        for (int x = 0; x < img->width; x++) {
-            Pixel sum = { 0, 0, 0 };
-
-            for (int kx = -radius; kx <= radius; kx++) {
-                Pixel pixel = get_pixel_with_padding(img, x + kx, y);
-                float weight = kernel[kx + radius];
-
-                sum.r += pixel.r * weight;
-                sum.g += pixel.g * weight;
-                sum.b += pixel.b * weight;
-            }
-
-            image_set_pixel(temp, x, y, sum);
-        }
-    }
-
-    //        
-    for (int y = 0; y < img->height; y++) {
-        for (int x = 0; x < img->width; x++) {
-            Pixel sum = { 0, 0, 0 };
-
-            for (int ky = -radius; ky <= radius; ky++) {
-                Pixel pixel = get_pixel_with_padding(temp, x, y + ky);
-                float weight = kernel[ky + radius];
-
-                sum.r += pixel.r * weight;
-                sum.g += pixel.g * weight;
-                sum.b += pixel.b * weight;
-            }
-
-            //  
-            sum.r = sum.r < 0.0f ? 0.0f : (sum.r > 1.0f ? 1.0f : sum.r);
-            sum.g = sum.g < 0.0f ? 0.0f : (sum.g > 1.0f ? 1.0f : sum.g);
-            sum.b = sum.b < 0.0f ? 0.0f : (sum.b > 1.0f ? 1.0f : sum.b);
-
-            image_set_pixel(img, x, y, sum);
-        }
-    }
-
-    //  
-    free(kernel);
-    image_destroy(temp);
-
-    return true;
+#include "filters.h"
+#include "custom_filters.h"
+#include "parallel.h"
+#include "simd.h"
+#include "median.h"
+#include "blur.h"
+#include "fixed_point.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <float.h>
+
+// Таблица доступных фильтров
+Filter available_filters[] = {
+    {"crop", filter_crop, 2, 4, IMAGE_LAYOUT_INTERLEAVED, filter_halo_none},
+    {"gs", filter_grayscale, 0, 0, IMAGE_LAYOUT_INTERLEAVED, filter_halo_none},
+    {"neg", filter_negative, 0, 0, IMAGE_LAYOUT_INTERLEAVED, filter_halo_none},
+    {"sharp", filter_sharpening, 0, 0, IMAGE_LAYOUT_INTERLEAVED, filter_halo_3x3},
+    {"edge", filter_edge_detection, 1, 1, IMAGE_LAYOUT_PLANAR, filter_halo_3x3},
+    {"med", filter_median, 1, 1, IMAGE_LAYOUT_PLANAR, filter_halo_median},
+    {"blur", filter_gaussian_blur, 1, 2, IMAGE_LAYOUT_INTERLEAVED, filter_halo_blur},
+    {"crystallize", filter_crystallize, 0, 2, IMAGE_LAYOUT_INTERLEAVED, NULL},
+    {"glass", filter_glass_distortion, 0, 3, IMAGE_LAYOUT_INTERLEAVED, NULL},
+    {"sepia", filter_sepia, 0, 0, IMAGE_LAYOUT_INTERLEAVED, filter_halo_none},
+    {"vignette", filter_vignette, 0, 2, IMAGE_LAYOUT_INTERLEAVED, NULL}
+};
+
+int filter_count = sizeof(available_filters) / sizeof(available_filters[0]);
+
+// Поточечные фильтры не зависят от соседних строк
+int filter_halo_none(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    return 0;
+}
+
+// Фильтры с ядром 3x3 используют по одной строке сверху и снизу
+int filter_halo_3x3(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    return 1;
+}
+
+int filter_halo_median(int argc, char** argv) {
+    int window_size = argc >= 1 ? atoi(argv[0]) : 0;
+    return window_size > 0 ? window_size / 2 : 0;
+}
+
+// Радиус ядра для свертки; у рекурсивного фильтра отклик бесконечный,
+// поэтому берется окрестность, за которой его вклад меньше кванта
+int filter_halo_blur(int argc, char** argv) {
+    float sigma = argc >= 1 ? (float)atof(argv[0]) : 0.0f;
+    if (sigma <= 0.0f) {
+        return 0;
+    }
+
+    bool recursive = argc >= 2 ? strcmp(argv[1], "iir") == 0 : sigma >= BLUR_RECURSIVE_MIN_SIGMA;
+    return (int)ceilf((recursive ? 6.0f : 3.0f) * sigma);
+}
+
+// Строка пикселей обрабатывается векторными ядрами как массив float
+_Static_assert(sizeof(Pixel) == 3 * sizeof(float), "Pixel must be three packed floats");
+
+// Вспомогательная функция для получения пикселя с учетом границ
+Pixel get_pixel_with_padding(Image* img, int x, int y) {
+    // Ограничиваем координаты границами изображения
+    int clamped_x = x;
+    if (clamped_x < 0) clamped_x = 0;
+    if (clamped_x >= img->width) clamped_x = img->width - 1;
+
+    int clamped_y = y;
+    if (clamped_y < 0) clamped_y = 0;
+    if (clamped_y >= img->height) clamped_y = img->height - 1;
+
+    return img->data[clamped_y][clamped_x];
+}
+
+// Задание матричного фильтра для обработки полосы строк
+typedef struct {
+    Image* src;
+    Image* dst;
+    float (*kernel)[3];
+} MatrixFilterTask;
+
+// Вычисляет один пиксель матричного фильтра с учетом границ
+static Pixel matrix_filter_pixel(Image* img, float (*kernel)[3], int x, int y) {
+    Pixel sum = { 0, 0, 0 };
+
+    // Свертка с ядром 3x3
+    for (int ky = -1; ky <= 1; ky++) {
+        for (int kx = -1; kx <= 1; kx++) {
+            Pixel pixel = get_pixel_with_padding(img, x + kx, y + ky);
+            float weight = kernel[ky + 1][kx + 1];
+
+            sum.r += pixel.r * weight;
+            sum.g += pixel.g * weight;
+            sum.b += pixel.b * weight;
+        }
+    }
+
+    // Ограничиваем значения
+    sum.r = sum.r < 0.0f ? 0.0f : (sum.r > 1.0f ? 1.0f : sum.r);
+    sum.g = sum.g < 0.0f ? 0.0f : (sum.g > 1.0f ? 1.0f : sum.g);
+    sum.b = sum.b < 0.0f ? 0.0f : (sum.b > 1.0f ? 1.0f : sum.b);
+
+    return sum;
+}
+
+static void matrix_filter_rows(void* context, int y_begin, int y_end) {
+    MatrixFilterTask* task = (MatrixFilterTask*)context;
+    Image* img = task->src;
+    float (*kernel)[3] = task->kernel;
+    int width = img->width;
+
+    // Веса ядра в порядке обхода скалярной версии
+    float weights[9];
+    for (int k = 0; k < 9; k++) {
+        weights[k] = kernel[k / 3][k % 3];
+    }
+
+    for (int y = y_begin; y < y_end; y++) {
+        // Внутренние пиксели строки считаются векторным ядром
+        if (width > 2) {
+            const float* taps[9];
+            for (int ky = -1; ky <= 1; ky++) {
+                int row = y + ky;
+                if (row < 0) row = 0;
+                if (row >= img->height) row = img->height - 1;
+
+                for (int kx = -1; kx <= 1; kx++) {
+                    taps[(ky + 1) * 3 + (kx + 1)] = (const float*)&img->data[row][1 + kx];
+                }
+            }
+
+            simd_weighted_sum(taps, weights, 9, (float*)&task->dst->data[y][1], 3 * (width - 2), true);
+        }
+
+        // Крайние столбцы обрабатываются с учетом границ
+        image_set_pixel(task->dst, 0, y, matrix_filter_pixel(img, kernel, 0, y));
+        if (width > 1) {
+            image_set_pixel(task->dst, width - 1, y, matrix_filter_pixel(img, kernel, width - 1, y));
+        }
+    }
+}
+
+// Функция для применения матричного фильтра 3x3
+bool apply_matrix_filter(Image* img, float kernel[3][3], char** error) {
+    if (!img) {
+        if (error) *error = "No image provided";
+        return false;
+    }
+
+    // 8-битное изображение сворачивается в целых числах
+    if (img->layout == IMAGE_LAYOUT_BYTES) {
+        if (!fixed_matrix_filter(img, kernel)) {
+            if (error) *error = "Cannot create temporary image";
+            return false;
+        }
+        return true;
+    }
+
+    if (!image_set_layout(img, IMAGE_LAYOUT_INTERLEAVED)) {
+        if (error) *error = "Cannot convert image layout";
+        return false;
+    }
+
+    // Результат пишется во второй буфер изображения
+    Image* temp = image_scratch(img);
+    if (!temp) {
+        if (error) *error = "Cannot create temporary image";
+        return false;
+    }
+
+    // Применяем матрицу к каждому пикселю
+    MatrixFilterTask task = { img, temp, kernel };
+    parallel_for_rows(img->height, matrix_filter_rows, &task);
+
+    // Результат становится изображением без копирования
+    image_swap_scratch(img);
+    return true;
+}
+
+// Реализация фильтра Crop: изображение становится окном на прямоугольник
+// без копирования пикселей
+bool filter_crop(Image* img, int argc, char** argv, char** error) {
+    if (argc < 2) {
+        if (error) *error = "Crop filter requires width and height parameters";
+        return false;
+    }
+
+    int new_width = atoi(argv[0]);
+    int new_height = atoi(argv[1]);
+
+    if (new_width <= 0 || new_height <= 0) {
+        if (error) *error = "Invalid crop dimensions";
+        return false;
+    }
+
+    // Необязательное смещение левого верхнего угла
+    int x = argc >= 4 ? atoi(argv[2]) : 0;
+    int y = argc >= 4 ? atoi(argv[3]) : 0;
+    if (argc == 3) {
+        if (error) *error = "Crop offset requires both x and y";
+        return false;
+    }
+
+    if (!img) {
+        if (error) *error = "No image provided";
+        return false;
+    }
+
+    if (x < 0 || y < 0 || x >= img->width || y >= img->height) {
+        if (error) *error = "Crop offset is outside the image";
+        return false;
+    }
+
+    // Запрошенные размеры ограничиваются оставшейся частью изображения
+    if (!image_crop_view(img, x, y, new_width, new_height)) {
+        if (error) *error = "Memory allocation failed";
+        return false;
+    }
+
+    return true;
+}
+
+static void grayscale_rows(void* context, int y_begin, int y_end) {
+    Image* img = (Image*)context;
+
+    // В плоской раскладке яркость записывается во все три плоскости
+    if (img->layout == IMAGE_LAYOUT_PLANAR) {
+        for (int y = y_begin; y < y_end; y++) {
+            float* r = image_plane_row(img, 0, y);
+            float* g = image_plane_row(img, 1, y);
+            float* b = image_plane_row(img, 2, y);
+            for (int x = 0; x < img->width; x++) {
+                float luminance = pixel_luminance(pixel_create(r[x], g[x], b[x]));
+                r[x] = g[x] = b[x] = luminance;
+            }
+        }
+        return;
+    }
+
+    for (int y = y_begin; y < y_end; y++) {
+        for (int x = 0; x < img->width; x++) {
+            Pixel* pixel = image_get_pixel(img, x, y);
+            if (!pixel) continue;
+
+            float luminance = pixel_luminance(*pixel);
+            *pixel = pixel_create(luminance, luminance, luminance);
+        }
+    }
+}
+
+// Реализация фильтра Grayscale
+bool filter_grayscale(Image* img, int argc, char** argv, char** error) {
+    (void)argc;
+    (void)argv;
+
+    if (!img) {
+        if (error) *error = "No image provided";
+        return false;
+    }
+
+    if (img->layout == IMAGE_LAYOUT_BYTES) {
+        fixed_grayscale(img);
+        return true;
+    }
+
+    parallel_for_rows(img->height, grayscale_rows, img);
+
+    return true;
+}
+
+static void negative_rows(void* context, int y_begin, int y_end) {
+    Image* img = (Image*)context;
+
+    for (int y = y_begin; y < y_end; y++) {
+        for (int x = 0; x < img->width; x++) {
+            Pixel* pixel = image_get_pixel(img, x, y);
+            if (!pixel) continue;
+
+            pixel->r = 1.0f - pixel->r;
+            pixel->g = 1.0f - pixel->g;
+            pixel->b = 1.0f - pixel->b;
+        }
+    }
+}
+
+// Реализация фильтра Negative
+bool filter_negative(Image* img, int argc, char** argv, char** error) {
+    (void)argc;
+    (void)argv;
+
+    if (!img) {
+        if (error) *error = "No image provided";
+        return false;
+    }
+
+    if (img->layout == IMAGE_LAYOUT_BYTES) {
+        fixed_negative(img);
+        return true;
+    }
+
+    if (!image_set_layout(img, IMAGE_LAYOUT_INTERLEAVED)) {
+        if (error) *error = "Cannot convert image layout";
+        return false;
+    }
+
+    parallel_for_rows(img->height, negative_rows, img);
+
+    return true;
+}
+
+// Реализация фильтра Sharpening
+bool filter_sharpening(Image* img, int argc, char** argv, char** error) {
+    (void)argc;
+    (void)argv;
+
+    if (!img) {
+        if (error) *error = "No image provided";
+        return false;
+    }
+
+    // Матрица для повышения резкости
+    float kernel[3][3] = {
+        { 0, -1,  0},
+        {-1,  5, -1},
+        { 0, -1,  0}
+    };
+
+    return apply_matrix_filter(img, kernel, error);
+}
+
+// Задание оператора Собеля для обработки полосы строк
+typedef struct {
+    Image* img;
+    float* luminance;  // Плоскость яркости, width значений на строку
+    float threshold_squared;
+} EdgeDetectionTask;
+
+static void luminance_rows(void* context, int y_begin, int y_end) {
+    EdgeDetectionTask* task = (EdgeDetectionTask*)context;
+    Image* img = task->img;
+
+    for (int y = y_begin; y < y_end; y++) {
+        const float* r = image_plane_row(img, 0, y);
+        const float* g = image_plane_row(img, 1, y);
+        const float* b = image_plane_row(img, 2, y);
+        float* output = task->luminance + (size_t)y * img->width;
+        for (int x = 0; x < img->width; x++) {
+            output[x] = pixel_luminance(pixel_create(r[x], g[x], b[x]));
+        }
+    }
+}
+
+static void edge_detection_rows(void* context, int y_begin, int y_end) {
+    EdgeDetectionTask* task = (EdgeDetectionTask*)context;
+    Image* img = task->img;
+    int width = img->width;
+
+    for (int y = y_begin; y < y_end; y++) {
+        int above = y > 0 ? y - 1 : 0;
+        int below = y + 1 < img->height ? y + 1 : img->height - 1;
+
+        // Результат (белый или черный) одинаков во всех каналах: считается
+        // в плоскость R и копируется в остальные
+        float* output = image_plane_row(img, 0, y);
+        simd_sobel_threshold(task->luminance + (size_t)above * width, task->luminance + (size_t)y * width,
+                             task->luminance + (size_t)below * width, output, width, task->threshold_squared);
+        memcpy(image_plane_row(img, 1, y), output, width * sizeof(float));
+        memcpy(image_plane_row(img, 2, y), output, width * sizeof(float));
+    }
+}
+
+// Реализация фильтра Edge Detection
+bool filter_edge_detection(Image* img, int argc, char** argv, char** error) {
+    if (argc < 1) {
+        if (error) *error = "Edge detection requires threshold parameter";
+        return false;
+    }
+
+    float threshold = (float)atof(argv[0]);
+    if (threshold < 0.0f || threshold > 1.0f) {
+        if (error) *error = "Threshold must be between 0 and 1";
+        return false;
+    }
+
+    if (!img) {
+        if (error) *error = "No image provided";
+        return false;
+    }
+
+    // Яркость и градиенты считаются по плоскостям
+    if (!image_set_layout(img, IMAGE_LAYOUT_PLANAR)) {
+        if (error) *error = "Cannot convert image layout";
+        return false;
+    }
+
+    // Вместо перевода всего изображения в оттенки серого яркость считается
+    // в одну плоскость; градиент сравнивается с порогом в квадрате, без корня
+    EdgeDetectionTask task = { img, NULL, threshold * threshold };
+    task.luminance = (float*)image_temp_alloc((size_t)img->width * img->height * sizeof(float));
+    if (!task.luminance) {
+        if (error) *error = "Memory allocation failed";
+        return false;
+    }
+
+    // Результат пишется поверх изображения: исходные пиксели больше не нужны
+    parallel_for_rows(img->height, luminance_rows, &task);
+    parallel_for_rows(img->height, edge_detection_rows, &task);
+
+    free(task.luminance);
+    return true;
+}
+
+// Реализация медианного фильтра (по каналам)
+bool filter_median(Image* img, int argc, char** argv, char** error) {
+    if (argc < 1) {
+        if (error) *error = "Median filter requires window size parameter";
+        return false;
+    }
+
+    int window_size = atoi(argv[0]);
+    if (window_size <= 0 || window_size % 2 == 0) {
+        if (error) *error = "Window size must be positive odd number";
+        return false;
+    }
+    if (window_size > MEDIAN_MAX_WINDOW) {
+        if (error) *error = "Window size must not exceed 65535";
+        return false;
+    }
+
+    if (!img) {
+        if (error) *error = "No image provided";
+        return false;
+    }
+
+    int radius = window_size / 2;
+
+    // Медиана считается отдельно по каждому каналу, поэтому по плоскостям;
+    // 8-битное изображение обрабатывается без перевода в float
+    if (img->layout != IMAGE_LAYOUT_BYTES && !image_set_layout(img, IMAGE_LAYOUT_PLANAR)) {
+        if (error) *error = "Cannot convert image layout";
+        return false;
+    }
+
+    // Результат пишется во второй буфер изображения
+    Image* temp = image_scratch(img);
+    if (!temp) {
+        if (error) *error = "Cannot create temporary image";
+        return false;
+    }
+
+    // Применяем медианный фильтр: малые окна считаются сортирующими сетями,
+    // большие - по гистограммам
+    bool done;
+    if (window_size <= MEDIAN_NETWORK_MAX_WINDOW) {
+        done = median_network(img, temp, radius);
+    }
+    else {
+        done = median_histogram(img, temp, radius);
+    }
+
+    if (!done) {
+        if (error) *error = "Memory allocation failed";
+        return false;
+    }
+
+    image_swap_scratch(img);
+    return true;
+}
+
+// Задание одного прохода размытия для обработки полосы строк
+typedef struct {
+    Image* src;
+    Image* dst;
+    const float* kernel;
+    int radius;
+} BlurPassTask;
+
+// Вычисляет один пиксель горизонтального прохода с учетом границ
+static Pixel blur_horizontal_pixel(Image* img, const float* kernel, int radius, int x, int y) {
+    Pixel sum = { 0, 0, 0 };
+
+    for (int kx = -radius; kx <= radius; kx++) {
+        Pixel pixel = get_pixel_with_padding(img, x + kx, y);
+        float weight = kernel[kx + radius];
+
+        sum.r += pixel.r * weight;
+        sum.g += pixel.g * weight;
+        sum.b += pixel.b * weight;
+    }
+
+    return sum;
+}
+
+static void blur_horizontal_rows(void* context, int y_begin, int y_end) {
+    BlurPassTask* task = (BlurPassTask*)context;
+    Image* img = task->src;
+    const float* kernel = task->kernel;
+    int radius = task->radius;
+    int kernel_size = 2 * radius + 1;
+
+    // Без буфера отводов вся строка считается скалярно
+    const float** taps = (const float**)malloc(kernel_size * sizeof(float*));
+    int inner_begin = radius;
+    int inner_end = img->width - radius;
+    if (!taps || inner_end <= inner_begin) {
+        inner_begin = inner_end = img->width;
+    }
+
+    for (int y = y_begin; y < y_end; y++) {
+        // Пиксели, для которых все ядро помещается в строку, считаются векторно
+        if (inner_begin < inner_end) {
+            for (int k = 0; k < kernel_size; k++) {
+                taps[k] = (const float*)&img->data[y][inner_begin - radius + k];
+            }
+            simd_weighted_sum(taps, kernel, kernel_size, (float*)&task->dst->data[y][inner_begin],
+                              3 * (inner_end - inner_begin), false);
+        }
+
+        // Края строки обрабатываются с учетом границ
+        for (int x = 0; x < inner_begin; x++) {
+            image_set_pixel(task->dst, x, y, blur_horizontal_pixel(img, kernel, radius, x, y));
+        }
+        for (int x = inner_end; x < img->width; x++) {
+            image_set_pixel(task->dst, x, y, blur_horizontal_pixel(img, kernel, radius, x, y));
+        }
+    }
+
+    free(taps);
+}
+
+static void blur_vertical_rows(void* context, int y_begin, int y_end) {
+    BlurPassTask* task = (BlurPassTask*)context;
+    Image* img = task->src;
+    const float* kernel = task->kernel;
+    int radius = task->radius;
+    int kernel_size = 2 * radius + 1;
+
+    const float** taps = (const float**)malloc(kernel_size * sizeof(float*));
+
+    for (int y = y_begin; y < y_end; y++) {
+        // Строки ядра выбираются с учетом границ, вся строка считается векторно
+        if (taps) {
+            for (int k = 0; k < kernel_size; k++) {
+                int row = y + k - radius;
+                if (row < 0) row = 0;
+                if (row >= img->height) row = img->height - 1;
+                taps[k] = (const float*)img->data[row];
+            }
+            simd_weighted_sum(taps, kernel, kernel_size, (float*)task->dst->data[y], 3 * img->width, true);
+            continue;
+        }
+
+        for (int x = 0; x < img->width; x++) {
+            Pixel sum = { 0, 0, 0 };
+
+            for (int ky = -radius; ky <= radius; ky++) {
+                Pixel pixel = get_pixel_with_padding(img, x, y + ky);
+                float weight = kernel[ky + radius];
+
+                sum.r += pixel.r * weight;
+                sum.g += pixel.g * weight;
+                sum.b += pixel.b * weight;
+            }
+
+            // Ограничиваем значения
+            sum.r = sum.r < 0.0f ? 0.0f : (sum.r > 1.0f ? 1.0f : sum.r);
+            sum.g = sum.g < 0.0f ? 0.0f : (sum.g > 1.0f ? 1.0f : sum.g);
+            sum.b = sum.b < 0.0f ? 0.0f : (sum.b > 1.0f ? 1.0f : sum.b);
+
+            image_set_pixel(task->dst, x, y, sum);
+        }
+    }
+
+    free(taps);
+}
+
+// Реализация Гауссова размытия
+bool filter_gaussian_blur(Image* img, int argc, char** argv, char** error) {
+    if (argc < 1) {
+        if (error) *error = "Gaussian blur requires sigma parameter";
+        return false;
+    }
+
+    float sigma = (float)atof(argv[0]);
+    if (sigma <= 0.0f) {
+        if (error) *error = "Sigma must be positive";
+        return false;
+    }
+
+    // Режим: fir - свертка с ядром, iir - рекурсивный фильтр;
+    // по умолчанию рекурсивный фильтр выбирается для больших сигм
+    bool recursive = sigma >= BLUR_RECURSIVE_MIN_SIGMA;
+    if (argc >= 2) {
+        if (strcmp(argv[1], "iir") == 0) {
+            recursive = true;
+        }
+        else if (strcmp(argv[1], "fir") == 0) {
+            recursive = false;
+        }
+        else {
+            if (error) *error = "Blur mode must be fir or iir";
+            return false;
+        }
+    }
+
+    if (recursive && sigma < 0.5f) {
+        if (error) *error = "Recursive blur requires sigma of at least 0.5";
+        return false;
+    }
+
+    if (!img) {
+        if (error) *error = "No image provided";
+        return false;
+    }
+
+    // 8-битное изображение размывается в целых числах
+    bool fixed = img->layout == IMAGE_LAYOUT_BYTES;
+    if (!fixed && !image_set_layout(img, IMAGE_LAYOUT_INTERLEAVED)) {
+        if (error) *error = "Cannot convert image layout";
+        return false;
+    }
+
+    if (recursive) {
+        if (!blur_recursive(img, sigma)) {
+            if (error) *error = "Memory allocation failed";
+            return false;
+        }
+        return true;
+    }
+
+    // Вычисляем размер ядра (правило 3?)
+    int radius = (int)ceilf(3 * sigma);
+    int kernel_size = 2 * radius + 1;
+
+    // Создаем и заполняем ядро Гаусса
+    float* kernel = (float*)malloc(kernel_size * sizeof(float));
+    if (!kernel) {
+        if (error) *error = "Memory allocation failed";
+        return false;
+    }
+
+    float sum = 0.0f;
+    for (int i = 0; i < kernel_size; i++) {
+        int x = i - radius;
+        kernel[i] = expf(-(x * x) / (2 * sigma * sigma));
+        sum += kernel[i];
+    }
+
+    // Нормализуем ядро
+    for (int i = 0; i < kernel_size; i++) {
+        kernel[i] /= sum;
+    }
+
+    if (fixed) {
+        bool done = fixed_gaussian_blur(img, kernel, radius);
+        free(kernel);
+        if (!done) {
+            if (error) *error = "Memory allocation failed";
+            return false;
+        }
+        return true;
+    }
+
+    // Промежуточный результат хранится во втором буфере изображения
+    Image* temp = image_scratch(img);
+    if (!temp) {
+        free(kernel);
+        if (error) *error = "Cannot create temporary image";
+        return false;
+    }
+
+    // Применяем размытие по горизонтали
+    BlurPassTask horizontal = { img, temp, kernel, radius };
+    parallel_for_rows(img->height, blur_horizontal_rows, &horizontal);
+
+    // Применяем размытие по вертикали к результату горизонтального размытия
+    BlurPassTask vertical = { temp, img, kernel, radius };
+    parallel_for_rows(img->height, blur_vertical_rows, &vertical);
+
+    // Освобождаем память
+    free(kernel);
+
+    return true;
 }
\ No newline at end of file
@@ -1,43 +1,62 @@
-#ifndef FILTERS_H
-#define FILTERS_H
-
-#include "image.h"
-
-//   
-typedef bool (*FilterFunction)(Image* img, int argc, char** argv, char** error);
-
-//    
-typedef struct {
-    const char* name;
-    FilterFunction function;
-    int min_args;  //   
-    int max_args;  //    (-1 =  )
-} Filter;
-
-//  
-bool filter_crop(Image* img, int argc, char** argv, char** error);
-bool filter_grayscale(Image* img, int argc, char** argv, char** error);
-bool filter_negative(Image* img, int argc, char** argv, char** error);
-bool filter_sharpening(Image* img, int argc, char** argv, char** error);
-bool filter_edge_detection(Image* img, int argc, char** argv, char** error);
-bool filter_median(Image* img, int argc, char** argv, char** error);
-bool filter_gaussian_blur(Image* img, int argc, char** argv, char** error);
-
-//  
-bool filter_crystallize(Image* img, int argc, char** argv, char** error);
-bool filter_glass_distortion(Image* img, int argc, char** argv, char** error);
-bool filter_sepia(Image* img, int argc, char** argv, char** error);
-bool filter_vignette(Image* img, int argc, char** argv, char** error);
-
-//  
-bool apply_matrix_filter(Image* img, float kernel[3][3], char** error);
-Pixel get_pixel_with_padding(Image* img, int x, int y);
-
-//   
-extern Filter available_filters[];
-extern int filter_count;
-
-//       
-Pixel get_pixel_with_padding(Image* img, int x, int y);
-
+#ifndef FILTERS_H
+#define FILTERS_H
+
+#include "image.h"
+
+// Тип функции фильтра
+typedef bool (*FilterFunction)(Image* img, int argc, char** argv, char** error);
+
+// Число соседних строк сверху и снизу, от которых зависит строка результата
+// (для потоковой обработки полосами)
+typedef int (*FilterHaloFunction)(int argc, char** argv);
+
+// Структура для описания фильтра
+typedef struct {
+    const char* name;
+    FilterFunction function;
+    int min_args;  // Минимальное количество аргументов
+    int max_args;  // Максимальное количество аргументов (-1 = без ограничений)
+    ImageLayout layout;  // Раскладка, с которой фильтр работает без преобразования
+    FilterHaloFunction halo;  // NULL, если фильтру нужно все изображение целиком
+} Filter;
+
+// Фильтр цепочки вместе с его аргументами
+typedef struct {
+    Filter* filter;
+    int argc;
+    char** argv;
+} FilterStep;
+
+// Базовые фильтры
+bool filter_crop(Image* img, int argc, char** argv, char** error);
+bool filter_grayscale(Image* img, int argc, char** argv, char** error);
+bool filter_negative(Image* img, int argc, char** argv, char** error);
+bool filter_sharpening(Image* img, int argc, char** argv, char** error);
+bool filter_edge_detection(Image* img, int argc, char** argv, char** error);
+bool filter_median(Image* img, int argc, char** argv, char** error);
+bool filter_gaussian_blur(Image* img, int argc, char** argv, char** error);
+
+// Дополнительные фильтры
+bool filter_crystallize(Image* img, int argc, char** argv, char** error);
+bool filter_glass_distortion(Image* img, int argc, char** argv, char** error);
+bool filter_sepia(Image* img, int argc, char** argv, char** error);
+bool filter_vignette(Image* img, int argc, char** argv, char** error);
+
+// Окрестности фильтров для потоковой обработки
+int filter_halo_none(int argc, char** argv);
+int filter_halo_3x3(int argc, char** argv);
+int filter_halo_median(int argc, char** argv);
+int filter_halo_blur(int argc, char** argv);
+
+// Вспомогательные функции
+bool apply_matrix_filter(Image* img, float kernel[3][3], char** error);
+Pixel get_pixel_with_padding(Image* img, int x, int y);
+
+// Таблица доступных фильтров
+extern Filter available_filters[];
+extern int filter_count;
+
+// Объявление функции для использования в других файлах
+Pixel get_pixel_with_padding(Image* img, int x, int y);
+
 #endif // FILTERS_H
\ No newline at end of file
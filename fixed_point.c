@@ -0,0 +1,260 @@
+#include "fixed_point.h"
+#include "parallel.h"
+#include <stdlib.h>
+#include <math.h>
+
+// Веса яркости в Q16, в сумме ровно 65536
+#define LUMA_R 19595
+#define LUMA_G 38470
+#define LUMA_B 7471
+
+// Дробные биты весов свертки 3x3 и Гауссова ядра
+#define MATRIX_SHIFT 8
+#define BLUR_SHIFT 14
+
+// Дробные биты промежуточного результата размытия (uint16)
+#define INTERMEDIATE_SHIFT 8
+
+// Матрица сепии в Q16
+static const uint32_t sepia_matrix[3][3] = {
+    { 25756, 50397, 12386 },  // 0.393, 0.769, 0.189
+    { 22872, 44958, 11010 },  // 0.349, 0.686, 0.168
+    { 17826, 34996,  8585 }   // 0.272, 0.534, 0.131
+};
+
+static inline int clamp_index(int value, int size) {
+    if (value < 0) return 0;
+    if (value >= size) return size - 1;
+    return value;
+}
+
+static void grayscale_rows(void* context, int y_begin, int y_end) {
+    Image* img = (Image*)context;
+
+    for (int y = y_begin; y < y_end; y++) {
+        uint8_t* row = img->bytes[y];
+        for (int x = 0; x < img->width; x++) {
+            uint8_t* pixel = &row[x * 3];
+            uint32_t luminance = (LUMA_R * pixel[0] + LUMA_G * pixel[1] + LUMA_B * pixel[2] + 32768) >> 16;
+            pixel[0] = pixel[1] = pixel[2] = (uint8_t)luminance;
+        }
+    }
+}
+
+void fixed_grayscale(Image* img) {
+    parallel_for_rows(img->height, grayscale_rows, img);
+}
+
+static void negative_rows(void* context, int y_begin, int y_end) {
+    Image* img = (Image*)context;
+
+    for (int y = y_begin; y < y_end; y++) {
+        uint8_t* row = img->bytes[y];
+        for (int i = 0; i < img->width * 3; i++) {
+            row[i] = (uint8_t)(255 - row[i]);
+        }
+    }
+}
+
+void fixed_negative(Image* img) {
+    parallel_for_rows(img->height, negative_rows, img);
+}
+
+static void sepia_rows(void* context, int y_begin, int y_end) {
+    Image* img = (Image*)context;
+
+    for (int y = y_begin; y < y_end; y++) {
+        uint8_t* row = img->bytes[y];
+        for (int x = 0; x < img->width; x++) {
+            uint8_t* pixel = &row[x * 3];
+            uint32_t r = pixel[0];
+            uint32_t g = pixel[1];
+            uint32_t b = pixel[2];
+
+            // Как и в float-версии, ограничивается только верхняя граница
+            for (int channel = 0; channel < 3; channel++) {
+                const uint32_t* weights = sepia_matrix[channel];
+                uint32_t value = (weights[0] * r + weights[1] * g + weights[2] * b + 32768) >> 16;
+                pixel[channel] = (uint8_t)(value > 255 ? 255 : value);
+            }
+        }
+    }
+}
+
+void fixed_sepia(Image* img) {
+    parallel_for_rows(img->height, sepia_rows, img);
+}
+
+// Задание свертки 3x3 для обработки полосы строк
+typedef struct {
+    Image* src;
+    Image* dst;
+    int32_t weights[9];
+} FixedMatrixTask;
+
+static void matrix_rows(void* context, int y_begin, int y_end) {
+    FixedMatrixTask* task = (FixedMatrixTask*)context;
+    Image* img = task->src;
+    int width = img->width;
+    const int32_t* weights = task->weights;
+
+    for (int y = y_begin; y < y_end; y++) {
+        const uint8_t* rows[3];
+        for (int ky = -1; ky <= 1; ky++) {
+            rows[ky + 1] = img->bytes[clamp_index(y + ky, img->height)];
+        }
+
+        uint8_t* output = task->dst->bytes[y];
+        for (int x = 0; x < width; x++) {
+            int columns[3] = { clamp_index(x - 1, width) * 3, x * 3, clamp_index(x + 1, width) * 3 };
+
+            for (int channel = 0; channel < 3; channel++) {
+                int32_t sum = 0;
+                for (int k = 0; k < 9; k++) {
+                    sum += weights[k] * rows[k / 3][columns[k % 3] + channel];
+                }
+
+                // Ограничиваем значения
+                int32_t value = sum <= 0 ? 0 : (sum + (1 << (MATRIX_SHIFT - 1))) >> MATRIX_SHIFT;
+                output[x * 3 + channel] = (uint8_t)(value > 255 ? 255 : value);
+            }
+        }
+    }
+}
+
+bool fixed_matrix_filter(Image* img, float kernel[3][3]) {
+    Image* temp = image_scratch(img);
+    if (!temp) {
+        return false;
+    }
+
+    FixedMatrixTask task;
+    task.src = img;
+    task.dst = temp;
+    for (int k = 0; k < 9; k++) {
+        task.weights[k] = (int32_t)lrintf(kernel[k / 3][k % 3] * (1 << MATRIX_SHIFT));
+    }
+
+    parallel_for_rows(img->height, matrix_rows, &task);
+
+    image_swap_scratch(img);
+    return true;
+}
+
+// Задание одного прохода целочисленного размытия
+typedef struct {
+    Image* img;
+    uint16_t* intermediate;  // Результат горизонтального прохода, width * 3 на строку
+    const uint32_t* weights;
+    int radius;
+    bool failed;
+} FixedBlurTask;
+
+static void blur_horizontal_rows(void* context, int y_begin, int y_end) {
+    FixedBlurTask* task = (FixedBlurTask*)context;
+    int width = task->img->width;
+    int radius = task->radius;
+    int kernel_size = 2 * radius + 1;
+    const uint32_t* weights = task->weights;
+
+    for (int y = y_begin; y < y_end; y++) {
+        const uint8_t* row = task->img->bytes[y];
+        uint16_t* output = task->intermediate + (size_t)y * width * 3;
+
+        for (int x = 0; x < width; x++) {
+            uint32_t sum[3] = { 0, 0, 0 };
+
+            if (x >= radius && x + radius < width) {
+                const uint8_t* pixel = &row[(x - radius) * 3];
+                for (int k = 0; k < kernel_size; k++) {
+                    sum[0] += weights[k] * pixel[k * 3];
+                    sum[1] += weights[k] * pixel[k * 3 + 1];
+                    sum[2] += weights[k] * pixel[k * 3 + 2];
+                }
+            }
+            else {
+                // Края строки обрабатываются с учетом границ
+                for (int k = 0; k < kernel_size; k++) {
+                    const uint8_t* pixel = &row[clamp_index(x + k - radius, width) * 3];
+                    sum[0] += weights[k] * pixel[0];
+                    sum[1] += weights[k] * pixel[1];
+                    sum[2] += weights[k] * pixel[2];
+                }
+            }
+
+            // Сумма весов равна 1 << BLUR_SHIFT, поэтому результат не превышает 255 << 8
+            for (int channel = 0; channel < 3; channel++) {
+                output[x * 3 + channel] = (uint16_t)((sum[channel] + (1u << (BLUR_SHIFT - INTERMEDIATE_SHIFT - 1)))
+                                                     >> (BLUR_SHIFT - INTERMEDIATE_SHIFT));
+            }
+        }
+    }
+}
+
+static void blur_vertical_rows(void* context, int y_begin, int y_end) {
+    FixedBlurTask* task = (FixedBlurTask*)context;
+    int width = task->img->width;
+    int height = task->img->height;
+    int radius = task->radius;
+    int kernel_size = 2 * radius + 1;
+    int count = width * 3;
+    const int shift = BLUR_SHIFT + INTERMEDIATE_SHIFT;
+
+    // Строка накапливается целиком, чтобы строки ядра читались последовательно
+    uint32_t* sums = (uint32_t*)image_temp_alloc((size_t)count * sizeof(uint32_t));
+    if (!sums) {
+        task->failed = true;
+        return;
+    }
+
+    for (int y = y_begin; y < y_end; y++) {
+        for (int i = 0; i < count; i++) {
+            sums[i] = 1u << (shift - 1);
+        }
+
+        for (int k = 0; k < kernel_size; k++) {
+            const uint16_t* source = task->intermediate + (size_t)clamp_index(y + k - radius, height) * count;
+            uint32_t weight = task->weights[k];
+            for (int i = 0; i < count; i++) {
+                sums[i] += weight * source[i];
+            }
+        }
+
+        uint8_t* output = task->img->bytes[y];
+        for (int i = 0; i < count; i++) {
+            uint32_t value = sums[i] >> shift;
+            output[i] = (uint8_t)(value > 255 ? 255 : value);
+        }
+    }
+
+    free(sums);
+}
+
+bool fixed_gaussian_blur(Image* img, const float* kernel, int radius) {
+    int kernel_size = 2 * radius + 1;
+
+    // Веса округляются так, чтобы их сумма осталась ровно 1 << BLUR_SHIFT:
+    // тогда однотонные области не меняются
+    uint32_t* weights = (uint32_t*)malloc(kernel_size * sizeof(uint32_t));
+    uint16_t* intermediate = (uint16_t*)image_temp_alloc((size_t)img->width * img->height * 3 * sizeof(uint16_t));
+    if (!weights || !intermediate) {
+        free(weights);
+        free(intermediate);
+        return false;
+    }
+
+    int32_t total = 0;
+    for (int k = 0; k < kernel_size; k++) {
+        weights[k] = (uint32_t)lrintf(kernel[k] * (1 << BLUR_SHIFT));
+        total += (int32_t)weights[k];
+    }
+    weights[radius] += (1 << BLUR_SHIFT) - total;
+
+    FixedBlurTask task = { img, intermediate, weights, radius, false };
+    parallel_for_rows(img->height, blur_horizontal_rows, &task);
+    parallel_for_rows(img->height, blur_vertical_rows, &task);
+
+    free(weights);
+    free(intermediate);
+    return !task.failed;
+}
@@ -0,0 +1,20 @@
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include "image.h"
+
+// Целочисленные версии фильтров для изображений в раскладке IMAGE_LAYOUT_BYTES.
+// Коэффициенты хранятся в фиксированной точке, промежуточные результаты
+// двухпроходных фильтров - в uint16 с 8 дробными битами
+
+void fixed_grayscale(Image* img);
+void fixed_negative(Image* img);
+void fixed_sepia(Image* img);
+
+// Свертка с ядром 3x3; веса округляются до 1/256
+bool fixed_matrix_filter(Image* img, float kernel[3][3]);
+
+// Разделимая свертка с нормированным ядром из 2 * radius + 1 весов
+bool fixed_gaussian_blur(Image* img, const float* kernel, int radius);
+
+#endif // FIXED_POINT_H
@@ -1,251 +1,1093 @@
-#include "image.h"
-#include <stdlib.h>
-#include <string.h>
-#include <stdio.h>
-
-Image* image_create(int width, int height) {
-    if (width <= 0 || height <= 0) {
-        return NULL;
-    }
-
-    Image* img = (Image*)malloc(sizeof(Image));
-    if (!img) {
-        return NULL;
-    }
-
-    img->width = width;
-    img->height = height;
-
-    //    
-    img->data = (Pixel**)malloc(height * sizeof(Pixel*));
-    if (!img->data) {
-        free(img);
-        return NULL;
-    }
-
-    //       
-    Pixel* pixels = (Pixel*)malloc(width * height * sizeof(Pixel));
-    if (!pixels) {
-        free(img->data);
-        free(img);
-        return NULL;
-    }
-
-    //    
-    for (int y = 0; y < height; y++) {
-        img->data[y] = &pixels[y * width];
-    }
-
-    //     
-    memset(pixels, 0, width * height * sizeof(Pixel));
-
-    return img;
-}
-
-void image_destroy(Image* img) {
-    if (img) {
-        if (img->data) {
-            if (img->data[0]) {
-                free(img->data[0]);
-            }
-            free(img->data);
-        }
-        free(img);
-    }
-}
-
-Pixel* image_get_pixel(Image* img, int x, int y) {
-    if (!img || x < 0 || x >= img->width || y < 0 || y >= img->height) {
-        return NULL;
-    }
-    return &img->data[y][x];
-}
-
-void image_set_pixel(Image* img, int x, int y, Pixel pixel) {
-    Pixel* p = image_get_pixel(img, x, y);
-    if (p) {
-        *p = pixel;
-    }
-}
-
-Image* bmp_load(const char* filename, char** error) {
-    FILE* file = fopen(filename, "rb");
-    if (!file) {
-        if (error) *error = "Cannot open file";
-        return NULL;
-    }
-
-    BMPFileHeader file_header;
-    BMPInfoHeader info_header;
-
-    //  
-    if (fread(&file_header, sizeof(BMPFileHeader), 1, file) != 1) {
-        fclose(file);
-        if (error) *error = "Cannot read BMP file header";
-        return NULL;
-    }
-
-    if (fread(&info_header, sizeof(BMPInfoHeader), 1, file) != 1) {
-        fclose(file);
-        if (error) *error = "Cannot read BMP info header";
-        return NULL;
-    }
-
-    //  
-    if (file_header.type != 0x4D42) {  // "BM"
-        fclose(file);
-        if (error) *error = "Not a BMP file";
-        return NULL;
-    }
-
-    //   
-    if (info_header.bits_per_pixel != 24) {
-        fclose(file);
-        if (error) *error = "Only 24-bit BMP supported";
-        return NULL;
-    }
-
-    if (info_header.compression != 0) {
-        fclose(file);
-        if (error) *error = "Compressed BMP not supported";
-        return NULL;
-    }
-
-    //    
-    fseek(file, file_header.offset, SEEK_SET);
-
-    //  
-    Image* img = image_create(info_header.width, abs(info_header.height));
-    if (!img) {
-        fclose(file);
-        if (error) *error = "Cannot create image";
-        return NULL;
-    }
-
-    //     
-    int row_size = ((info_header.width * 3 + 3) / 4) * 4;
-    uint8_t* row_buffer = (uint8_t*)malloc(row_size);
-    if (!row_buffer) {
-        image_destroy(img);
-        fclose(file);
-        if (error) *error = "Memory allocation failed";
-        return NULL;
-    }
-
-    //   
-    int height = abs(info_header.height);
-    for (int y = 0; y < height; y++) {
-        if (fread(row_buffer, 1, row_size, file) != row_size) {
-            free(row_buffer);
-            image_destroy(img);
-            fclose(file);
-            if (error) *error = "Cannot read pixel data";
-            return NULL;
-        }
-
-        //    
-        for (int x = 0; x < info_header.width; x++) {
-            //  BMP  BGR
-            uint8_t b = row_buffer[x * 3];
-            uint8_t g = row_buffer[x * 3 + 1];
-            uint8_t r = row_buffer[x * 3 + 2];
-
-            //   ,    
-            int target_y = info_header.height > 0 ? height - 1 - y : y;
-            image_set_pixel(img, x, target_y, pixel_from_bytes(r, g, b));
-        }
-    }
-
-    free(row_buffer);
-    fclose(file);
-
-    return img;
-}
-
-bool bmp_save(const char* filename, Image* img, char** error) {
-    if (!img) {
-        if (error) *error = "No image to save";
-        return false;
-    }
-
-    FILE* file = fopen(filename, "wb");
-    if (!file) {
-        if (error) *error = "Cannot create file";
-        return false;
-    }
-
-    //     
-    int row_size = ((img->width * 3 + 3) / 4) * 4;
-    int image_size = row_size * img->height;
-
-    //  
-    BMPFileHeader file_header = { 0 };
-    BMPInfoHeader info_header = { 0 };
-
-    file_header.type = 0x4D42;  // "BM"
-    file_header.size = sizeof(BMPFileHeader) + sizeof(BMPInfoHeader) + image_size;
-    file_header.offset = sizeof(BMPFileHeader) + sizeof(BMPInfoHeader);
-
-    info_header.size = sizeof(BMPInfoHeader);
-    info_header.width = img->width;
-    info_header.height = img->height;
-    info_header.planes = 1;
-    info_header.bits_per_pixel = 24;
-    info_header.compression = 0;
-    info_header.image_size = image_size;
-    info_header.x_pixels_per_meter = 2835;  //  72 DPI
-    info_header.y_pixels_per_meter = 2835;
-    info_header.colors_used = 0;
-    info_header.colors_important = 0;
-
-    //  
-    if (fwrite(&file_header, sizeof(BMPFileHeader), 1, file) != 1 ||
-        fwrite(&info_header, sizeof(BMPInfoHeader), 1, file) != 1) {
-        fclose(file);
-        if (error) *error = "Cannot write headers";
-        return false;
-    }
-
-    //    
-    uint8_t* row_buffer = (uint8_t*)calloc(1, row_size);
-    if (!row_buffer) {
-        fclose(file);
-        if (error) *error = "Memory allocation failed";
-        return false;
-    }
-
-    //    (   BMP)
-    for (int y = img->height - 1; y >= 0; y--) {
-        for (int x = 0; x < img->width; x++) {
-            Pixel* pixel = image_get_pixel(img, x, y);
-            uint8_t r, g, b;
-            pixel_to_bytes(*pixel, &r, &g, &b);
-
-            //  BMP  BGR
-            row_buffer[x * 3] = b;
-            row_buffer[x * 3 + 1] = g;
-            row_buffer[x * 3 + 2] = r;
-        }
-
-        if (fwrite(row_buffer, 1, row_size, file) != row_size) {
-            free(row_buffer);
-            fclose(file);
-            if (error) *error = "Cannot write pixel data";
-            return false;
-        }
-    }
-
-    free(row_buffer);
-    fclose(file);
-    return true;
-}
-
-void print_bmp_info(BMPFileHeader* file_header, BMPInfoHeader* info_header) {
-    printf("BMP File Info:\n");
-    printf("  Signature: %c%c\n", file_header->type & 0xFF, file_header->type >> 8);
-    printf("  File size: %u bytes\n", file_header->size);
-    printf("  Data offset: %u\n", file_header->offset);
-    printf("  Image size: %dx%d\n", info_header->width, info_header->height);
-    printf("  Bits per pixel: %u\n", info_header->bits_per_pixel);
-    printf("  Compression: %u\n", info_header->compression);
+#include "image.h"
+#include "parallel.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Выделяет выровненный блок памяти под пиксели
+static void* block_alloc(size_t size) {
+#ifdef _WIN32
+    return _aligned_malloc(size, IMAGE_PLANE_ALIGNMENT);
+#else
+    void* block = NULL;
+    if (posix_memalign(&block, IMAGE_PLANE_ALIGNMENT, size) != 0) {
+        return NULL;
+    }
+    return block;
+#endif
+}
+
+static void block_free(void* block) {
+#ifdef _WIN32
+    _aligned_free(block);
+#else
+    free(block);
+#endif
+}
+
+// Каталог файлов подкачки для больших блоков или NULL
+static char* scratch_directory = NULL;
+
+bool image_set_scratch_directory(const char* directory, char** error) {
+    free(scratch_directory);
+    scratch_directory = NULL;
+    if (!directory) {
+        return true;
+    }
+
+#ifndef _WIN32
+    struct stat info;
+    if (stat(directory, &info) != 0 || !S_ISDIR(info.st_mode)) {
+        if (error) *error = "Scratch directory does not exist";
+        return false;
+    }
+
+    scratch_directory = strdup(directory);
+    if (!scratch_directory) {
+        if (error) *error = "Memory allocation failed";
+        return false;
+    }
+    return true;
+#else
+    if (error) *error = "Scratch files are not supported on this platform";
+    return false;
+#endif
+}
+
+#ifndef _WIN32
+
+// Отображает в память новый временный файл размера size. Файл удаляется сразу,
+// поэтому исчезает вместе с отображением. Место на диске резервируется заранее:
+// иначе нехватка места обнаружилась бы только при записи страницы (SIGBUS)
+static void* scratch_map(size_t size) {
+    char path[4096];
+    int length = snprintf(path, sizeof(path), "%s/image_craft_XXXXXX", scratch_directory);
+    if (length < 0 || (size_t)length >= sizeof(path)) {
+        return NULL;
+    }
+
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return NULL;
+    }
+    unlink(path);
+
+    void* memory = NULL;
+    if (posix_fallocate(fd, 0, (off_t)size) == 0) {
+        memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (memory == MAP_FAILED) {
+            memory = NULL;
+        }
+    }
+
+    close(fd);
+    return memory;
+}
+
+#endif
+
+// Всего выделено байт под пиксели и временные буферы; блоки создаются
+// и в рабочих потоках пакета
+static uint64_t allocated_bytes = 0;
+
+static void count_allocation(size_t size) {
+#ifdef __GNUC__
+    __atomic_fetch_add(&allocated_bytes, size, __ATOMIC_RELAXED);
+#else
+    allocated_bytes += size;
+#endif
+}
+
+uint64_t image_allocated_bytes(void) {
+#ifdef __GNUC__
+    return __atomic_load_n(&allocated_bytes, __ATOMIC_RELAXED);
+#else
+    return allocated_bytes;
+#endif
+}
+
+void* image_temp_alloc(size_t size) {
+    void* memory = malloc(size);
+    if (memory) {
+        count_allocation(size);
+    }
+    return memory;
+}
+
+void* image_temp_calloc(size_t count, size_t size) {
+    void* memory = calloc(count, size);
+    if (memory) {
+        count_allocation(count * size);
+    }
+    return memory;
+}
+
+// Создает общий блок из size обнуленных байт с одной ссылкой
+static ImageBuffer* buffer_create(size_t size) {
+    ImageBuffer* buffer = (ImageBuffer*)malloc(sizeof(ImageBuffer));
+    if (!buffer) {
+        return NULL;
+    }
+
+    buffer->memory = NULL;
+    buffer->mapped_size = 0;
+#ifndef _WIN32
+    // Файл подкачки уже заполнен нулями; если отобразить его не удалось,
+    // блок выделяется в памяти
+    if (scratch_directory && size >= IMAGE_SCRATCH_MIN_BYTES) {
+        buffer->memory = scratch_map(size);
+        buffer->mapped_size = buffer->memory ? size : 0;
+    }
+#endif
+
+    if (!buffer->memory) {
+        buffer->memory = block_alloc(size);
+        if (!buffer->memory) {
+            free(buffer);
+            return NULL;
+        }
+        memset(buffer->memory, 0, size);
+    }
+    buffer->refs = 1;
+
+    count_allocation(size);
+    return buffer;
+}
+
+// Снимает ссылку; последняя ссылка освобождает пиксели
+static void buffer_release(ImageBuffer* buffer) {
+    if (buffer && --buffer->refs == 0) {
+#ifndef _WIN32
+        if (buffer->mapped_size > 0) {
+            munmap(buffer->memory, buffer->mapped_size);
+        }
+        else
+#endif
+        block_free(buffer->memory);
+        free(buffer);
+    }
+}
+
+// Выделяет обнуленное хранилище пикселей в заданной раскладке
+static bool image_alloc_storage(Image* img, ImageLayout layout) {
+    int width = img->width;
+    int height = img->height;
+
+    img->layout = layout;
+    img->data = NULL;
+    img->planes[0] = img->planes[1] = img->planes[2] = NULL;
+    img->stride = 0;
+    img->bytes = NULL;
+    img->buffer = NULL;
+
+    if (layout == IMAGE_LAYOUT_PLANAR) {
+        // Строки плоскостей выравниваются, плоскости лежат одним блоком
+        int floats_per_line = IMAGE_PLANE_ALIGNMENT / sizeof(float);
+        img->stride = (width + floats_per_line - 1) / floats_per_line * floats_per_line;
+
+        size_t plane_size = (size_t)img->stride * height;
+        if (plane_size > SIZE_MAX / (3 * sizeof(float))) {
+            return false;
+        }
+        img->buffer = buffer_create(3 * plane_size * sizeof(float));
+        if (!img->buffer) {
+            return false;
+        }
+
+        float* block = (float*)img->buffer->memory;
+        for (int channel = 0; channel < 3; channel++) {
+            img->planes[channel] = block + channel * plane_size;
+        }
+        return true;
+    }
+
+    // Строки 8-битного изображения и изображения из Pixel лежат одним блоком
+    size_t row_bytes = (size_t)width * (layout == IMAGE_LAYOUT_BYTES ? 3 : sizeof(Pixel));
+    if ((size_t)height > SIZE_MAX / row_bytes) {
+        return false;
+    }
+    img->buffer = buffer_create(row_bytes * height);
+    if (!img->buffer) {
+        return false;
+    }
+
+    // Настраиваем указатели на строки
+    uint8_t* block = (uint8_t*)img->buffer->memory;
+    if (layout == IMAGE_LAYOUT_BYTES) {
+        img->bytes = (uint8_t**)malloc(height * sizeof(uint8_t*));
+        for (int y = 0; img->bytes && y < height; y++) {
+            img->bytes[y] = block + y * row_bytes;
+        }
+    }
+    else {
+        img->data = (Pixel**)malloc(height * sizeof(Pixel*));
+        for (int y = 0; img->data && y < height; y++) {
+            img->data[y] = (Pixel*)(block + y * row_bytes);
+        }
+    }
+
+    if (!img->data && !img->bytes) {
+        buffer_release(img->buffer);
+        img->buffer = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+// Освобождает таблицы строк и снимает ссылку на пиксели
+static void image_free_storage(Image* img) {
+    free(img->data);
+    img->data = NULL;
+    free(img->bytes);
+    img->bytes = NULL;
+    img->planes[0] = img->planes[1] = img->planes[2] = NULL;
+
+    buffer_release(img->buffer);
+    img->buffer = NULL;
+}
+
+Image* image_create(int width, int height) {
+    return image_create_layout(width, height, IMAGE_LAYOUT_INTERLEAVED);
+}
+
+Image* image_create_layout(int width, int height, ImageLayout layout) {
+    if (width <= 0 || height <= 0 || width > IMAGE_MAX_DIMENSION || height > IMAGE_MAX_DIMENSION) {
+        return NULL;
+    }
+
+    Image* img = (Image*)malloc(sizeof(Image));
+    if (!img) {
+        return NULL;
+    }
+
+    img->width = width;
+    img->height = height;
+    img->scratch = NULL;
+
+    if (!image_alloc_storage(img, layout)) {
+        free(img);
+        return NULL;
+    }
+
+    return img;
+}
+
+void image_destroy(Image* img) {
+    if (img) {
+        image_destroy(img->scratch);
+        image_free_storage(img);
+        free(img);
+    }
+}
+
+// Окно на прямоугольник (x, y, width, height) изображения src без копирования
+// пикселей: окно ссылается на тот же блок и видит изменения исходного изображения.
+// Прямоугольник обрезается границами src
+Image* image_create_view(Image* src, int x, int y, int width, int height) {
+    if (!src || x < 0 || y < 0 || x >= src->width || y >= src->height || width <= 0 || height <= 0) {
+        return NULL;
+    }
+    if (width > src->width - x) width = src->width - x;
+    if (height > src->height - y) height = src->height - y;
+
+    Image* view = (Image*)malloc(sizeof(Image));
+    if (!view) {
+        return NULL;
+    }
+
+    *view = *src;
+    view->width = width;
+    view->height = height;
+    view->data = NULL;
+    view->bytes = NULL;
+    view->scratch = NULL;
+
+    // В плоской раскладке достаточно сдвинуть начала плоскостей,
+    // в остальных строится таблица строк окна
+    if (src->layout == IMAGE_LAYOUT_PLANAR) {
+        for (int channel = 0; channel < 3; channel++) {
+            view->planes[channel] = image_plane_row(src, channel, y) + x;
+        }
+    }
+    else if (src->layout == IMAGE_LAYOUT_BYTES) {
+        view->bytes = (uint8_t**)malloc(height * sizeof(uint8_t*));
+        if (!view->bytes) {
+            free(view);
+            return NULL;
+        }
+        for (int row = 0; row < height; row++) {
+            view->bytes[row] = src->bytes[y + row] + x * 3;
+        }
+    }
+    else {
+        view->data = (Pixel**)malloc(height * sizeof(Pixel*));
+        if (!view->data) {
+            free(view);
+            return NULL;
+        }
+        for (int row = 0; row < height; row++) {
+            view->data[row] = src->data[y + row] + x;
+        }
+    }
+
+    view->buffer->refs++;
+    return view;
+}
+
+// Превращает изображение в окно на свой прямоугольник (x, y, width, height)
+bool image_crop_view(Image* img, int x, int y, int width, int height) {
+    Image* view = image_create_view(img, x, y, width, height);
+    if (!view) {
+        return false;
+    }
+
+    // Размер меняется, поэтому второй буфер больше не подходит
+    image_destroy(img->scratch);
+    image_free_storage(img);
+    *img = *view;
+    free(view);
+    return true;
+}
+
+Image* image_scratch(Image* img) {
+    Image* scratch = img->scratch;
+    if (scratch && scratch->width == img->width && scratch->height == img->height &&
+        scratch->layout == img->layout) {
+        return scratch;
+    }
+
+    image_destroy(scratch);
+    img->scratch = image_create_layout(img->width, img->height, img->layout);
+    return img->scratch;
+}
+
+// Меняет местами хранилища изображения и второго буфера
+void image_swap_scratch(Image* img) {
+    Image* scratch = img->scratch;
+    Image front = *img;
+
+    *img = *scratch;
+    img->scratch = scratch;
+    *scratch = front;
+    scratch->scratch = NULL;
+}
+
+// Возвращает NULL для плоской раскладки: в ней нет структур Pixel
+Pixel* image_get_pixel(Image* img, int x, int y) {
+    if (!img || img->layout != IMAGE_LAYOUT_INTERLEAVED || x < 0 || x >= img->width || y < 0 || y >= img->height) {
+        return NULL;
+    }
+    return &img->data[y][x];
+}
+
+void image_set_pixel(Image* img, int x, int y, Pixel pixel) {
+    if (img && img->layout == IMAGE_LAYOUT_PLANAR) {
+        if (x >= 0 && x < img->width && y >= 0 && y < img->height) {
+            image_plane_row(img, 0, y)[x] = pixel.r;
+            image_plane_row(img, 1, y)[x] = pixel.g;
+            image_plane_row(img, 2, y)[x] = pixel.b;
+        }
+        return;
+    }
+
+    if (img && img->layout == IMAGE_LAYOUT_BYTES) {
+        if (x >= 0 && x < img->width && y >= 0 && y < img->height) {
+            uint8_t* bytes = &img->bytes[y][x * 3];
+            pixel_to_bytes(pixel, &bytes[0], &bytes[1], &bytes[2]);
+        }
+        return;
+    }
+
+    Pixel* p = image_get_pixel(img, x, y);
+    if (p) {
+        *p = pixel;
+    }
+}
+
+float* image_plane_row(Image* img, int channel, int y) {
+    return img->planes[channel] + (size_t)y * img->stride;
+}
+
+// Задание перестановки каналов между раскладками
+typedef struct {
+    Image* src;
+    Image* dst;
+    bool failed;
+} LayoutConversionTask;
+
+// Читает строку изображения любой раскладки в массив Pixel
+static void read_row(Image* img, int y, Pixel* pixels) {
+    if (img->layout == IMAGE_LAYOUT_INTERLEAVED) {
+        memcpy(pixels, img->data[y], img->width * sizeof(Pixel));
+    }
+    else if (img->layout == IMAGE_LAYOUT_PLANAR) {
+        const float* r = image_plane_row(img, 0, y);
+        const float* g = image_plane_row(img, 1, y);
+        const float* b = image_plane_row(img, 2, y);
+        for (int x = 0; x < img->width; x++) {
+            pixels[x] = pixel_create(r[x], g[x], b[x]);
+        }
+    }
+    else {
+        const uint8_t* bytes = img->bytes[y];
+        for (int x = 0; x < img->width; x++) {
+            pixels[x] = pixel_from_bytes(bytes[x * 3], bytes[x * 3 + 1], bytes[x * 3 + 2]);
+        }
+    }
+}
+
+// Записывает массив Pixel в строку изображения любой раскладки
+static void write_row(Image* img, int y, const Pixel* pixels) {
+    if (img->layout == IMAGE_LAYOUT_INTERLEAVED) {
+        memcpy(img->data[y], pixels, img->width * sizeof(Pixel));
+    }
+    else if (img->layout == IMAGE_LAYOUT_PLANAR) {
+        float* r = image_plane_row(img, 0, y);
+        float* g = image_plane_row(img, 1, y);
+        float* b = image_plane_row(img, 2, y);
+        for (int x = 0; x < img->width; x++) {
+            r[x] = pixels[x].r;
+            g[x] = pixels[x].g;
+            b[x] = pixels[x].b;
+        }
+    }
+    else {
+        uint8_t* bytes = img->bytes[y];
+        for (int x = 0; x < img->width; x++) {
+            pixel_to_bytes(pixels[x], &bytes[x * 3], &bytes[x * 3 + 1], &bytes[x * 3 + 2]);
+        }
+    }
+}
+
+static void convert_layout_rows(void* context, int y_begin, int y_end) {
+    LayoutConversionTask* task = (LayoutConversionTask*)context;
+
+    // Строка переводится через промежуточный буфер Pixel
+    Pixel* pixels = (Pixel*)malloc(task->src->width * sizeof(Pixel));
+    if (!pixels) {
+        task->failed = true;
+        return;
+    }
+
+    for (int y = y_begin; y < y_end; y++) {
+        read_row(task->src, y, pixels);
+        write_row(task->dst, y, pixels);
+    }
+
+    free(pixels);
+}
+
+// Переводит хранилище в нужную раскладку; если она уже такая, ничего не делает
+bool image_set_layout(Image* img, ImageLayout layout) {
+    if (!img) {
+        return false;
+    }
+    if (img->layout == layout) {
+        return true;
+    }
+
+    // Второй буфер в старой раскладке не нужен, освобождаем его до выделения нового хранилища
+    image_destroy(img->scratch);
+    img->scratch = NULL;
+
+    Image converted = *img;
+    if (!image_alloc_storage(&converted, layout)) {
+        return false;
+    }
+
+    LayoutConversionTask task = { img, &converted, false };
+    parallel_for_rows(img->height, convert_layout_rows, &task);
+    if (task.failed) {
+        image_free_storage(&converted);
+        return false;
+    }
+
+    image_free_storage(img);
+    *img = converted;
+    return true;
+}
+
+// Копирует пиксели между изображениями одного размера и раскладки
+void image_copy_pixels(Image* dst, Image* src) {
+    for (int y = 0; y < src->height; y++) {
+        if (src->layout == IMAGE_LAYOUT_PLANAR) {
+            for (int channel = 0; channel < 3; channel++) {
+                memcpy(image_plane_row(dst, channel, y), image_plane_row(src, channel, y),
+                       src->width * sizeof(float));
+            }
+        }
+        else if (src->layout == IMAGE_LAYOUT_BYTES) {
+            memcpy(dst->bytes[y], src->bytes[y], (size_t)src->width * 3);
+        }
+        else {
+            memcpy(dst->data[y], src->data[y], src->width * sizeof(Pixel));
+        }
+    }
+}
+
+Image* bmp_load(const char* filename, char** error) {
+    return bmp_load_layout(filename, IMAGE_LAYOUT_INTERLEAVED, error);
+}
+
+// Переводит строку пикселей BMP (BGR) в строку y изображения
+void bmp_decode_row(Image* img, int y, const uint8_t* source) {
+    if (img->layout == IMAGE_LAYOUT_BYTES) {
+        // В 8-битной раскладке меняется только порядок каналов
+        uint8_t* bytes = img->bytes[y];
+        for (int x = 0; x < img->width; x++) {
+            bytes[x * 3] = source[x * 3 + 2];
+            bytes[x * 3 + 1] = source[x * 3 + 1];
+            bytes[x * 3 + 2] = source[x * 3];
+        }
+    }
+    else if (img->layout == IMAGE_LAYOUT_PLANAR) {
+        color_bgr_to_planes(source, image_plane_row(img, 0, y), image_plane_row(img, 1, y),
+                            image_plane_row(img, 2, y), img->width);
+    }
+    else {
+        color_bgr_to_pixels(source, img->data[y], img->width);
+    }
+}
+
+// Проверяет, что заголовки описывают поддерживаемый BMP
+static bool bmp_check_headers(const BMPFileHeader* file_header, const BMPInfoHeader* info_header,
+                              char** error) {
+    // Проверяем сигнатуру
+    if (file_header->type != 0x4D42) {  // "BM"
+        if (error) *error = "Not a BMP file";
+        return false;
+    }
+
+    // Проверяем поддерживаемый формат
+    if (info_header->bits_per_pixel != 24) {
+        if (error) *error = "Only 24-bit BMP supported";
+        return false;
+    }
+
+    if (info_header->compression != 0) {
+        if (error) *error = "Compressed BMP not supported";
+        return false;
+    }
+
+    // Высота INT32_MIN не имеет модуля в int32
+    if (info_header->width <= 0 || info_header->width > IMAGE_MAX_DIMENSION ||
+        info_header->height == 0 || info_header->height < -IMAGE_MAX_DIMENSION ||
+        info_header->height > IMAGE_MAX_DIMENSION) {
+        if (error) *error = "Unsupported BMP dimensions";
+        return false;
+    }
+
+    return true;
+}
+
+// Проверяет заголовки и создает изображение под данные пикселей
+static Image* bmp_create_from_headers(const BMPFileHeader* file_header, const BMPInfoHeader* info_header,
+                                      ImageLayout layout, char** error) {
+    if (!bmp_check_headers(file_header, info_header, error)) {
+        return NULL;
+    }
+
+    Image* img = image_create_layout(info_header->width, abs(info_header->height), layout);
+    if (!img) {
+        if (error) *error = "Cannot create image";
+    }
+    return img;
+}
+
+// Задание разбора BMP в памяти
+typedef struct {
+    Image* img;
+    const uint8_t* pixels;  // Начало данных пикселей
+    size_t row_size;        // Размер строки с выравниванием
+    bool bottom_up;         // Строки хранятся снизу вверх
+} BmpDecodeTask;
+
+static void bmp_decode_rows(void* context, int y_begin, int y_end) {
+    BmpDecodeTask* task = (BmpDecodeTask*)context;
+    int height = task->img->height;
+
+    for (int y = y_begin; y < y_end; y++) {
+        int source_y = task->bottom_up ? height - 1 - y : y;
+        bmp_decode_row(task->img, y, task->pixels + (size_t)source_y * task->row_size);
+    }
+}
+
+// Разбирает BMP в памяти (например, отображенный файл): заголовки проверяются на месте,
+// строки переводятся параллельно
+Image* bmp_load_memory(const uint8_t* data, size_t size, ImageLayout layout, char** error) {
+    BMPFileHeader file_header;
+    BMPInfoHeader info_header;
+
+    if (size < sizeof(BMPFileHeader)) {
+        if (error) *error = "Cannot read BMP file header";
+        return NULL;
+    }
+    if (size < sizeof(BMPFileHeader) + sizeof(BMPInfoHeader)) {
+        if (error) *error = "Cannot read BMP info header";
+        return NULL;
+    }
+
+    memcpy(&file_header, data, sizeof(BMPFileHeader));
+    memcpy(&info_header, data + sizeof(BMPFileHeader), sizeof(BMPInfoHeader));
+
+    Image* img = bmp_create_from_headers(&file_header, &info_header, layout, error);
+    if (!img) {
+        return NULL;
+    }
+
+    // Все строки должны помещаться в файл
+    size_t row_size = ((size_t)img->width * 3 + 3) / 4 * 4;
+    if (file_header.offset > size || (size - file_header.offset) / row_size < (size_t)img->height) {
+        image_destroy(img);
+        if (error) *error = "Cannot read pixel data";
+        return NULL;
+    }
+
+    BmpDecodeTask task = { img, data + file_header.offset, row_size, info_header.height > 0 };
+    parallel_for_rows(img->height, bmp_decode_rows, &task);
+
+    return img;
+}
+
+// Читает BMP из потока построчно; подходит и для каналов, где нет mmap и fseek
+static Image* bmp_load_stream(FILE* file, ImageLayout layout, char** error) {
+    BMPFileHeader file_header;
+    BMPInfoHeader info_header;
+
+    // Читаем заголовки
+    if (fread(&file_header, sizeof(BMPFileHeader), 1, file) != 1) {
+        if (error) *error = "Cannot read BMP file header";
+        return NULL;
+    }
+
+    if (fread(&info_header, sizeof(BMPInfoHeader), 1, file) != 1) {
+        if (error) *error = "Cannot read BMP info header";
+        return NULL;
+    }
+
+    Image* img = bmp_create_from_headers(&file_header, &info_header, layout, error);
+    if (!img) {
+        return NULL;
+    }
+
+    // Вычисляем размер строки с выравниванием
+    size_t row_size = ((size_t)img->width * 3 + 3) / 4 * 4;
+    uint8_t* row_buffer = (uint8_t*)malloc(row_size);
+    if (!row_buffer) {
+        image_destroy(img);
+        if (error) *error = "Memory allocation failed";
+        return NULL;
+    }
+
+    // Переходим к данным пикселей, пропуская байты между заголовками и данными
+    int64_t position = sizeof(BMPFileHeader) + sizeof(BMPInfoHeader);
+    while (position < (int64_t)file_header.offset) {
+        size_t chunk = file_header.offset - position;
+        if (chunk > row_size) chunk = row_size;
+        if (fread(row_buffer, 1, chunk, file) != chunk) {
+            break;
+        }
+        position += (int64_t)chunk;
+    }
+
+    // Читаем данные пикселей
+    int height = img->height;
+    for (int y = 0; y < height; y++) {
+        if (position < (int64_t)file_header.offset || fread(row_buffer, 1, row_size, file) != row_size) {
+            free(row_buffer);
+            image_destroy(img);
+            if (error) *error = "Cannot read pixel data";
+            return NULL;
+        }
+
+        // Если высота отрицательная, изображение хранится сверху вниз
+        int target_y = info_header.height > 0 ? height - 1 - y : y;
+        bmp_decode_row(img, target_y, row_buffer);
+    }
+
+    free(row_buffer);
+    return img;
+}
+
+Image* bmp_load_layout(const char* filename, ImageLayout layout, char** error) {
+#ifndef _WIN32
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        if (error) *error = "Cannot open file";
+        return NULL;
+    }
+
+    // Обычный файл отображается в память целиком
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            close(fd);
+            madvise(data, (size_t)info.st_size, MADV_WILLNEED);
+            Image* img = bmp_load_memory((const uint8_t*)data, (size_t)info.st_size, layout, error);
+            munmap(data, (size_t)info.st_size);
+            return img;
+        }
+    }
+
+    // Каналы и устройства читаются через буферизованный поток
+    FILE* file = fdopen(fd, "rb");
+    if (!file) {
+        close(fd);
+        if (error) *error = "Cannot open file";
+        return NULL;
+    }
+#else
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        if (error) *error = "Cannot open file";
+        return NULL;
+    }
+#endif
+
+    Image* img = bmp_load_stream(file, layout, error);
+    fclose(file);
+    return img;
+}
+
+// Переводит строку y изображения в строку пикселей BMP (BGR)
+void bmp_encode_row(Image* img, int y, uint8_t* row) {
+    if (img->layout == IMAGE_LAYOUT_BYTES) {
+        // 8-битные строки записываются без перевода в float
+        const uint8_t* bytes = img->bytes[y];
+        for (int x = 0; x < img->width; x++) {
+            row[x * 3] = bytes[x * 3 + 2];
+            row[x * 3 + 1] = bytes[x * 3 + 1];
+            row[x * 3 + 2] = bytes[x * 3];
+        }
+    }
+    else if (img->layout == IMAGE_LAYOUT_PLANAR) {
+        color_planes_to_bgr(image_plane_row(img, 0, y), image_plane_row(img, 1, y),
+                            image_plane_row(img, 2, y), row, img->width);
+    }
+    else {
+        color_pixels_to_bgr(img->data[y], row, img->width);
+    }
+}
+
+// Заполняет заголовки 24-битного BMP; отрицательная высота означает хранение сверху вниз
+static void bmp_fill_headers(int width, int height, BMPFileHeader* file_header, BMPInfoHeader* info_header) {
+    // Вычисляем размер строки с выравниванием; поля размеров 32-битные, и для
+    // файлов больше 4 ГБ в них записывается 0 (читатели берут размеры из ширины и высоты)
+    uint64_t row_size = ((uint64_t)width * 3 + 3) / 4 * 4;
+    uint64_t image_size = row_size * (uint64_t)(height < 0 ? -(int64_t)height : height);
+    uint64_t file_size = sizeof(BMPFileHeader) + sizeof(BMPInfoHeader) + image_size;
+
+    memset(file_header, 0, sizeof(BMPFileHeader));
+    memset(info_header, 0, sizeof(BMPInfoHeader));
+
+    file_header->type = 0x4D42;  // "BM"
+    file_header->size = file_size <= UINT32_MAX ? (uint32_t)file_size : 0;
+    file_header->offset = sizeof(BMPFileHeader) + sizeof(BMPInfoHeader);
+
+    info_header->size = sizeof(BMPInfoHeader);
+    info_header->width = width;
+    info_header->height = height;
+    info_header->planes = 1;
+    info_header->bits_per_pixel = 24;
+    info_header->compression = 0;
+    info_header->image_size = image_size <= UINT32_MAX ? (uint32_t)image_size : 0;
+    info_header->x_pixels_per_meter = 2835;  // Примерно 72 DPI
+    info_header->y_pixels_per_meter = 2835;
+    info_header->colors_used = 0;
+    info_header->colors_important = 0;
+}
+
+bool bmp_save(const char* filename, Image* img, char** error) {
+    if (!img) {
+        if (error) *error = "No image to save";
+        return false;
+    }
+
+    FILE* file = fopen(filename, "wb");
+    if (!file) {
+        if (error) *error = "Cannot create file";
+        return false;
+    }
+
+    bool done = bmp_save_stream(file, img, error);
+    if (fclose(file) != 0 && done) {
+        if (error) *error = "Cannot write pixel data";
+        done = false;
+    }
+    return done;
+}
+
+// Часть файла на поток, которая кодируется и пишется одним вызовом: буфер
+// остается в кэше между кодированием и записью
+#define BMP_ENCODE_CHUNK_BYTES ((size_t)1 << 20)
+
+// Задание кодирования части строк файла; строки файла идут снизу вверх
+typedef struct {
+    Image* img;
+    uint8_t* buffer;
+    size_t row_size;
+    int first_row;  // Номер первой строки части в порядке файла
+} BmpEncodeTask;
+
+static void bmp_encode_rows(void* context, int row_begin, int row_end) {
+    BmpEncodeTask* task = (BmpEncodeTask*)context;
+    int height = task->img->height;
+
+    for (int row = row_begin; row < row_end; row++) {
+        int y = height - 1 - (task->first_row + row);
+        bmp_encode_row(task->img, y, task->buffer + (size_t)row * task->row_size);
+    }
+}
+
+bool bmp_save_stream(FILE* file, Image* img, char** error) {
+    // Заполняем заголовки
+    BMPFileHeader file_header;
+    BMPInfoHeader info_header;
+    bmp_fill_headers(img->width, img->height, &file_header, &info_header);
+    size_t row_size = ((size_t)img->width * 3 + 3) / 4 * 4;
+
+    // Записываем заголовки
+    if (fwrite(&file_header, sizeof(BMPFileHeader), 1, file) != 1 ||
+        fwrite(&info_header, sizeof(BMPInfoHeader), 1, file) != 1) {
+        if (error) *error = "Cannot write headers";
+        return false;
+    }
+
+    // Строки кодируются параллельно в общий буфер и пишутся частями по
+    // BMP_ENCODE_CHUNK_BYTES на поток: крупные записи без построчных вызовов stdio,
+    // а буфер не удваивает память под изображение. Байты выравнивания остаются нулевыми
+    int threads = parallel_get_threads();
+    size_t chunk_bytes = BMP_ENCODE_CHUNK_BYTES * (threads < 16 ? threads : 16);
+    int chunk_rows = (int)(chunk_bytes / row_size);
+    if (chunk_rows < 1) chunk_rows = 1;
+    if (chunk_rows > img->height) chunk_rows = img->height;
+
+    uint8_t* buffer = (uint8_t*)calloc(chunk_rows, row_size);
+    if (!buffer) {
+        if (error) *error = "Memory allocation failed";
+        return false;
+    }
+
+    BmpEncodeTask task = { img, buffer, row_size, 0 };
+    for (int first = 0; first < img->height; first += chunk_rows) {
+        int rows = img->height - first < chunk_rows ? img->height - first : chunk_rows;
+        task.first_row = first;
+        parallel_for_rows(rows, bmp_encode_rows, &task);
+
+        if (fwrite(buffer, row_size, rows, file) != (size_t)rows) {
+            free(buffer);
+            if (error) *error = "Cannot write pixel data";
+            return false;
+        }
+    }
+
+    free(buffer);
+    return true;
+}
+
+// Переходит к позиции в файле; смещения больше 2 ГБ поддерживаются и на Windows
+static bool file_seek(FILE* file, int64_t position) {
+#ifdef _WIN32
+    return _fseeki64(file, position, SEEK_SET) == 0;
+#else
+    return fseeko(file, (off_t)position, SEEK_SET) == 0;
+#endif
+}
+
+bool file_is_same(const char* first, const char* second) {
+#ifdef _WIN32
+    return strcmp(first, second) == 0;
+#else
+    struct stat first_info;
+    struct stat second_info;
+    if (stat(first, &first_info) != 0 || stat(second, &second_info) != 0) {
+        return false;
+    }
+    return first_info.st_dev == second_info.st_dev && first_info.st_ino == second_info.st_ino;
+#endif
+}
+
+bool bmp_reader_open(BmpReader* reader, const char* filename, char** error) {
+    memset(reader, 0, sizeof(BmpReader));
+
+    reader->file = fopen(filename, "rb");
+    if (!reader->file) {
+        if (error) *error = "Cannot open file";
+        return false;
+    }
+
+    BMPFileHeader file_header;
+    BMPInfoHeader info_header;
+    char* failure = NULL;
+    if (fread(&file_header, sizeof(BMPFileHeader), 1, reader->file) != 1) {
+        failure = "Cannot read BMP file header";
+    }
+    else if (fread(&info_header, sizeof(BMPInfoHeader), 1, reader->file) != 1) {
+        failure = "Cannot read BMP info header";
+    }
+    else if (!bmp_check_headers(&file_header, &info_header, error)) {
+        bmp_reader_close(reader);
+        return false;
+    }
+
+    if (failure) {
+        bmp_reader_close(reader);
+        if (error) *error = failure;
+        return false;
+    }
+
+    reader->width = info_header.width;
+    reader->height = abs(info_header.height);
+    reader->row_size = ((size_t)reader->width * 3 + 3) / 4 * 4;
+    reader->data_offset = file_header.offset;
+    reader->bottom_up = info_header.height > 0;
+    reader->next_row = 0;
+
+    // Строки хранятся снизу вверх, а выдаются сверху вниз: нужен произвольный доступ
+    if (reader->bottom_up && !file_seek(reader->file, reader->data_offset)) {
+        bmp_reader_close(reader);
+        if (error) *error = "Streaming a bottom-up BMP requires a seekable input";
+        return false;
+    }
+
+    // Для хранения сверху вниз пропускаем байты до данных пикселей чтением
+    int64_t position = sizeof(BMPFileHeader) + sizeof(BMPInfoHeader);
+    while (!reader->bottom_up && position < reader->data_offset) {
+        if (fgetc(reader->file) == EOF) {
+            bmp_reader_close(reader);
+            if (error) *error = "Cannot read pixel data";
+            return false;
+        }
+        position++;
+    }
+
+    return true;
+}
+
+// Читает следующую строку (сверху вниз) в row, не меньше row_size байт
+bool bmp_reader_read_row(BmpReader* reader, uint8_t* row, char** error) {
+    if (reader->next_row >= reader->height) {
+        if (error) *error = "Cannot read pixel data";
+        return false;
+    }
+
+    if (reader->bottom_up) {
+        int64_t position = reader->data_offset + (int64_t)(reader->height - 1 - reader->next_row) * reader->row_size;
+        if (!file_seek(reader->file, position)) {
+            if (error) *error = "Cannot read pixel data";
+            return false;
+        }
+    }
+
+    if (fread(row, 1, reader->row_size, reader->file) != reader->row_size) {
+        if (error) *error = "Cannot read pixel data";
+        return false;
+    }
+
+    reader->next_row++;
+    return true;
+}
+
+void bmp_reader_close(BmpReader* reader) {
+    if (reader->file) {
+        fclose(reader->file);
+        reader->file = NULL;
+    }
+}
+
+bool bmp_writer_open(BmpWriter* writer, const char* filename, int width, int height, char** error) {
+    memset(writer, 0, sizeof(BmpWriter));
+
+    writer->file = fopen(filename, "wb");
+    if (!writer->file) {
+        if (error) *error = "Cannot create file";
+        return false;
+    }
+
+    // В обычный файл строки пишутся по местам (снизу вверх, как bmp_save),
+    // в канал - подряд с отрицательной высотой
+    writer->width = width;
+    writer->height = height;
+    writer->row_size = ((size_t)width * 3 + 3) / 4 * 4;
+    writer->bottom_up = file_seek(writer->file, 0);
+    writer->next_row = 0;
+
+    writer->row_buffer = (uint8_t*)calloc(1, writer->row_size);
+    if (!writer->row_buffer) {
+        bmp_writer_close(writer, NULL);
+        if (error) *error = "Memory allocation failed";
+        return false;
+    }
+
+    BMPFileHeader file_header;
+    BMPInfoHeader info_header;
+    bmp_fill_headers(width, writer->bottom_up ? height : -height, &file_header, &info_header);
+    writer->data_offset = file_header.offset;
+
+    if (fwrite(&file_header, sizeof(BMPFileHeader), 1, writer->file) != 1 ||
+        fwrite(&info_header, sizeof(BMPInfoHeader), 1, writer->file) != 1) {
+        bmp_writer_close(writer, NULL);
+        if (error) *error = "Cannot write headers";
+        return false;
+    }
+
+    return true;
+}
+
+// Записывает строку y изображения img как следующую строку файла (сверху вниз)
+bool bmp_writer_write_row(BmpWriter* writer, Image* img, int y, char** error) {
+    if (writer->next_row >= writer->height) {
+        if (error) *error = "Cannot write pixel data";
+        return false;
+    }
+
+    bmp_encode_row(img, y, writer->row_buffer);
+
+    if (writer->bottom_up) {
+        int64_t position = writer->data_offset + (int64_t)(writer->height - 1 - writer->next_row) * writer->row_size;
+        if (!file_seek(writer->file, position)) {
+            if (error) *error = "Cannot write pixel data";
+            return false;
+        }
+    }
+
+    if (fwrite(writer->row_buffer, 1, writer->row_size, writer->file) != writer->row_size) {
+        if (error) *error = "Cannot write pixel data";
+        return false;
+    }
+
+    writer->next_row++;
+    return true;
+}
+
+bool bmp_writer_close(BmpWriter* writer, char** error) {
+    bool done = true;
+    if (writer->file) {
+        done = fclose(writer->file) == 0;
+        writer->file = NULL;
+    }
+    free(writer->row_buffer);
+    writer->row_buffer = NULL;
+
+    if (!done && error) *error = "Cannot write pixel data";
+    return done;
+}
+
+void print_bmp_info(BMPFileHeader* file_header, BMPInfoHeader* info_header) {
+    printf("BMP File Info:\n");
+    printf("  Signature: %c%c\n", file_header->type & 0xFF, file_header->type >> 8);
+    printf("  File size: %u bytes\n", file_header->size);
+    printf("  Data offset: %u\n", file_header->offset);
+    printf("  Image size: %dx%d\n", info_header->width, info_header->height);
+    printf("  Bits per pixel: %u\n", info_header->bits_per_pixel);
+    printf("  Compression: %u\n", info_header->compression);
 }
\ No newline at end of file
@@ -1,50 +1,158 @@
-#ifndef IMAGE_H
-#define IMAGE_H
-
-#include "color.h"
-#include <stdint.h>
-#include <stdbool.h>
-#include <stdio.h>
-
-#pragma pack(push, 1)
-typedef struct {
-    uint16_t type;              //  "BM"
-    uint32_t size;              //    
-    uint16_t reserved1;         // 
-    uint16_t reserved2;         // 
-    uint32_t offset;            //    
-} BMPFileHeader;
-
-typedef struct {
-    uint32_t size;              //   (40 )
-    int32_t width;              //    
-    int32_t height;             //    
-    uint16_t planes;            //   (  1)
-    uint16_t bits_per_pixel;    //    (  24)
-    uint32_t compression;       //   (0 -  )
-    uint32_t image_size;        //   
-    int32_t x_pixels_per_meter; //  
-    int32_t y_pixels_per_meter; //  
-    uint32_t colors_used;       //   
-    uint32_t colors_important;  //   
-} BMPInfoHeader;
-#pragma pack(pop)
-
-typedef struct {
-    int width;
-    int height;
-    Pixel** data;  //    [height][width]
-} Image;
-
-//     
-Image* image_create(int width, int height);
-void image_destroy(Image* img);
-Pixel* image_get_pixel(Image* img, int x, int y);
-void image_set_pixel(Image* img, int x, int y, Pixel pixel);
-
-//     BMP
-Image* bmp_load(const char* filename, char** error);
-bool bmp_save(const char* filename, Image* img, char** error);
-void print_bmp_info(BMPFileHeader* file_header, BMPInfoHeader* info_header);
-
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include "color.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#pragma pack(push, 1)
+typedef struct {
+    uint16_t type;              // Сигнатура "BM"
+    uint32_t size;              // Размер файла в байтах
+    uint16_t reserved1;         // Зарезервировано
+    uint16_t reserved2;         // Зарезервировано
+    uint32_t offset;            // Смещение до данных пикселей
+} BMPFileHeader;
+
+typedef struct {
+    uint32_t size;              // Размер структуры (40 байт)
+    int32_t width;              // Ширина изображения в пикселях
+    int32_t height;             // Высота изображения в пикселях
+    uint16_t planes;            // Число плоскостей (должно быть 1)
+    uint16_t bits_per_pixel;    // Бит на пиксель (должно быть 24)
+    uint32_t compression;       // Тип сжатия (0 - без сжатия)
+    uint32_t image_size;        // Размер данных изображения
+    int32_t x_pixels_per_meter; // Горизонтальное разрешение
+    int32_t y_pixels_per_meter; // Вертикальное разрешение
+    uint32_t colors_used;       // Число используемых цветов
+    uint32_t colors_important;  // Число важных цветов
+} BMPInfoHeader;
+#pragma pack(pop)
+
+// Раскладка пикселей в памяти
+typedef enum {
+    IMAGE_LAYOUT_INTERLEAVED,  // Пиксели (r, g, b) подряд, доступ через data
+    IMAGE_LAYOUT_PLANAR,       // Отдельные выровненные плоскости R, G, B
+    IMAGE_LAYOUT_BYTES         // 8 бит на канал (r, g, b) подряд, доступ через bytes
+} ImageLayout;
+
+// Выравнивание плоскостей и их строк в байтах
+#define IMAGE_PLANE_ALIGNMENT 64
+
+// Наибольшие ширина и высота: смещения внутри строки (width * 3 float) помещаются в int,
+// а размеры блоков считаются в size_t
+#define IMAGE_MAX_DIMENSION (1 << 24)
+
+// Блоки пикселей не меньше этого размера попадают в файл подкачки, если он задан
+#define IMAGE_SCRATCH_MIN_BYTES ((size_t)64 << 20)
+
+// Блок пикселей с подсчетом ссылок: его могут разделять изображение и окна на него.
+// Ссылки меняются без синхронизации, только из управляющего потока
+typedef struct {
+    void* memory;
+    int refs;
+    size_t mapped_size;  // Размер отображения файла подкачки или 0, если блок в памяти
+} ImageBuffer;
+
+typedef struct Image {
+    int width;
+    int height;
+    Pixel** data;  // Двумерный массив пикселей [height][width] (только IMAGE_LAYOUT_INTERLEAVED)
+    ImageLayout layout;
+    float* planes[3];  // Плоскости каналов (только IMAGE_LAYOUT_PLANAR)
+    int stride;        // Число float между началами соседних строк плоскости
+    uint8_t** bytes;   // Строки по width * 3 байт (только IMAGE_LAYOUT_BYTES)
+    ImageBuffer* buffer;  // Блок, в котором лежат пиксели
+    struct Image* scratch;  // Второй буфер для фильтров с окрестностью или NULL
+} Image;
+
+// Построчное чтение BMP: строки выдаются сверху вниз независимо от порядка
+// хранения; для хранения снизу вверх вход должен поддерживать позиционирование
+typedef struct {
+    FILE* file;
+    int width;
+    int height;
+    size_t row_size;      // Размер строки файла с выравниванием
+    int64_t data_offset;  // Смещение данных пикселей
+    bool bottom_up;
+    int next_row;
+} BmpReader;
+
+// Построчная запись BMP: строки принимаются сверху вниз
+typedef struct {
+    FILE* file;
+    int width;
+    int height;
+    size_t row_size;
+    int64_t data_offset;
+    bool bottom_up;       // Файл позиционируется, строки пишутся снизу вверх
+    int next_row;
+    uint8_t* row_buffer;
+} BmpWriter;
+
+// Функции для работы с изображением
+Image* image_create(int width, int height);
+Image* image_create_layout(int width, int height, ImageLayout layout);
+void image_destroy(Image* img);
+Pixel* image_get_pixel(Image* img, int x, int y);
+void image_set_pixel(Image* img, int x, int y, Pixel pixel);
+
+// Окна на часть изображения без копирования пикселей
+Image* image_create_view(Image* src, int x, int y, int width, int height);
+bool image_crop_view(Image* img, int x, int y, int width, int height);
+
+// Второй буфер (front/back): фильтр пишет результат в image_scratch(img)
+// и меняет буферы местами через image_swap_scratch вместо копирования обратно.
+// Буфер живет вместе с изображением и переиспользуется следующими фильтрами
+Image* image_scratch(Image* img);
+void image_swap_scratch(Image* img);
+
+// Функции для работы с раскладкой
+bool image_set_layout(Image* img, ImageLayout layout);
+float* image_plane_row(Image* img, int channel, int y);
+void image_copy_pixels(Image* dst, Image* src);
+
+// Сколько байт всего выделено под пиксели изображений и временные буферы
+// фильтров (для профилирования)
+uint64_t image_allocated_bytes(void);
+
+// malloc и calloc для временных буферов фильтров, учитываемые в
+// image_allocated_bytes; освобождаются обычным free
+void* image_temp_alloc(size_t size);
+void* image_temp_calloc(size_t count, size_t size);
+
+// Хранение больших изображений вне оперативной памяти: блоки пикселей от
+// IMAGE_SCRATCH_MIN_BYTES отображаются в удаленные временные файлы каталога
+// directory, и система подгружает их страницы по мере обращения фильтров,
+// вытесняя давно не используемые. NULL отключает. Только POSIX; вызывается
+// до создания изображений
+bool image_set_scratch_directory(const char* directory, char** error);
+
+// Функции для работы с BMP
+Image* bmp_load(const char* filename, char** error);
+Image* bmp_load_layout(const char* filename, ImageLayout layout, char** error);
+bool bmp_save(const char* filename, Image* img, char** error);
+
+// Загрузка из BMP в памяти и запись в открытый поток (файл закрывает вызывающий)
+Image* bmp_load_memory(const uint8_t* data, size_t size, ImageLayout layout, char** error);
+bool bmp_save_stream(FILE* file, Image* img, char** error);
+void print_bmp_info(BMPFileHeader* file_header, BMPInfoHeader* info_header);
+
+// Перевод строк между форматом BMP (BGR с выравниванием) и изображением
+void bmp_decode_row(Image* img, int y, const uint8_t* source);
+void bmp_encode_row(Image* img, int y, uint8_t* row);
+
+// Функции для потокового чтения и записи BMP
+bool bmp_reader_open(BmpReader* reader, const char* filename, char** error);
+bool bmp_reader_read_row(BmpReader* reader, uint8_t* row, char** error);
+void bmp_reader_close(BmpReader* reader);
+bool bmp_writer_open(BmpWriter* writer, const char* filename, int width, int height, char** error);
+bool bmp_writer_write_row(BmpWriter* writer, Image* img, int y, char** error);
+bool bmp_writer_close(BmpWriter* writer, char** error);
+
+// true, если оба пути ведут к одному существующему файлу (по устройству и inode,
+// а не по написанию пути: "a.bmp" и "./a.bmp" - один файл)
+bool file_is_same(const char* first, const char* second);
+
 #endif // IMAGE_H
\ No newline at end of file
@@ -1,123 +1,332 @@
-﻿#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include "image.h"
-#include "filters.h"
-
-void print_help() {
-    printf("Usage: image_craft <input.bmp> <output.bmp> [filters...]\n");
-    printf("\nBasic filters:\n");
-    printf("  -crop width height      Crop image\n");
-    printf("  -gs                     Convert to grayscale\n");
-    printf("  -neg                    Convert to negative\n");
-    printf("  -sharp                  Apply sharpening\n");
-    printf("  -edge threshold         Edge detection\n");
-    printf("  -med window_size        Median filter\n");
-    printf("  -blur sigma             Gaussian blur\n");
-    printf("\nAdditional filters:\n");
-    printf("  -crystallize            Crystallize effect (Voronoi cells)\n");
-    printf("  -glass                  Glass distortion effect\n");
-    printf("  -sepia                  Apply sepia tone\n");
-    printf("  -vignette               Apply vignette effect\n");
-    printf("\nExamples:\n");
-    printf("  image_craft input.bmp output.bmp -crop 800 600 -gs -blur 0.5\n");
-    printf("  image_craft input.bmp output.bmp -neg -vignette\n");
-    printf("  image_craft input.bmp output.bmp -crystallize -sepia\n");
-}
-
-int main(int argc, char* argv[]) {
-    // Проверка аргументов командной строки
-    if (argc < 3) {
-        print_help();
-        return 0;
-    }
-
-    const char* input_filename = argv[1];
-    const char* output_filename = argv[2];
-
-    printf("Loading image: %s\n", input_filename);
-
-    // Загружаем изображение
-    char* error = NULL;
-    Image* img = bmp_load(input_filename, &error);
-    if (!img) {
-        fprintf(stderr, "Error loading image: %s\n", error);
-        return 1;
-    }
-
-    printf("Image loaded: %dx%d pixels\n", img->width, img->height);
-
-    // Обрабатываем фильтры, если они указаны
-    if (argc > 3) {
-        for (int i = 3; i < argc; i++) {
-            if (argv[i][0] == '-') {
-                char* filter_name = argv[i] + 1; // Пропускаем '-'
-
-                // Ищем фильтр в таблице
-                Filter* filter = NULL;
-                for (int j = 0; j < filter_count; j++) {
-                    if (strcmp(available_filters[j].name, filter_name) == 0) {
-                        filter = &available_filters[j];
-                        break;
-                    }
-                }
-
-                if (!filter) {
-                    fprintf(stderr, "Unknown filter: %s\n", filter_name);
-                    image_destroy(img);
-                    return 1;
-                }
-
-                // Собираем аргументы для фильтра
-                int args_count = 0;
-                char** filter_args = NULL;
-
-                // Подсчитываем аргументы фильтра
-                int j = i + 1;
-                while (j < argc && argv[j][0] != '-') {
-                    args_count++;
-                    j++;
-                }
-
-                // Проверяем количество аргументов
-                if (args_count < filter->min_args ||
-                    (filter->max_args != -1 && args_count > filter->max_args)) {
-                    fprintf(stderr, "Invalid number of arguments for filter %s\n", filter_name);
-                    image_destroy(img);
-                    return 1;
-                }
-
-                // Если есть аргументы, копируем их
-                if (args_count > 0) {
-                    filter_args = &argv[i + 1];
-                }
-
-                printf("Applying filter: %s\n", filter_name);
-
-                // Применяем фильтр
-                if (!filter->function(img, args_count, filter_args, &error)) {
-                    fprintf(stderr, "Error applying filter %s: %s\n", filter_name, error);
-                    image_destroy(img);
-                    return 1;
-                }
-
-                // Пропускаем обработанные аргументы
-                i += args_count;
-            }
-        }
-    }
-
-    // Сохраняем результат
-    printf("Saving image: %s\n", output_filename);
-    if (!bmp_save(output_filename, img, &error)) {
-        fprintf(stderr, "Error saving image: %s\n", error);
-        image_destroy(img);
-        return 1;
-    }
-
-    // Освобождаем память
-    image_destroy(img);
-
-    printf("Done!\n");
-    return 0;
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "image.h"
+#include "filters.h"
+#include "parallel.h"
+#include "stream.h"
+#include "pipeline.h"
+#include "batch.h"
+#include "profile.h"
+#include "serve.h"
+#include "custom_filters.h"
+
+void print_help() {
+    printf("Usage: image_craft <input.bmp> <output.bmp> [filters...]\n");
+    printf("       image_craft -batch <inputs> <output_pattern> [filters...]\n");
+    printf("       image_craft -serve <socket> [-threads count]\n");
+    printf("\nBasic filters:\n");
+    printf("  -crop w h [x y]         Crop image (offset defaults to 0 0)\n");
+    printf("  -gs                     Convert to grayscale\n");
+    printf("  -neg                    Convert to negative\n");
+    printf("  -sharp                  Apply sharpening\n");
+    printf("  -edge threshold         Edge detection\n");
+    printf("  -med window_size        Median filter\n");
+    printf("  -blur sigma [fir|iir]   Gaussian blur (recursive for sigma >= 3 by default)\n");
+    printf("\nAdditional filters:\n");
+    printf("  -crystallize [N [seed]] Crystallize effect (N Voronoi cells, default 50)\n");
+    printf("  -glass [scale [strength [seed]]]\n");
+    printf("                          Glass distortion effect (default 0.05 10 0)\n");
+    printf("  -sepia                  Apply sepia tone\n");
+    printf("  -vignette [strength [min]]\n");
+    printf("                          Apply vignette effect (default 0.7 0.3)\n");
+    printf("\nOptions:\n");
+    printf("  -threads count          Number of worker threads\n");
+    printf("                          (default: IMAGE_CRAFT_THREADS or CPU count)\n");
+    printf("  -8bit                   Keep pixels as 8-bit integers (4x less memory)\n");
+    printf("  -stream                 Process the image in row strips without loading it whole\n");
+    printf("                          (crop, gs, neg, sharp, edge, med, blur, sepia)\n");
+    printf("  -scratch dir            Keep images of 64 MB and more in memory-mapped temporary files\n");
+    printf("                          in dir, paged in on demand (images larger than RAM)\n");
+    printf("  -profile [file.jsonl]   Time, CPU time, MP/s, allocations and peak RSS per stage:\n");
+    printf("                          a table after processing, or JSON lines appended to file\n");
+    printf("  -counters               Add hardware counters to the profile (Linux perf events):\n");
+    printf("                          IPC, LLC and branch misses per pixel for every stage\n");
+    printf("                          (-profile and -counters may also be written --profile, --counters)\n");
+    printf("\nBatch mode:\n");
+    printf("  inputs                  Directory (*.bmp), quoted pattern (\"in/*.bmp\")\n");
+    printf("                          or @list.txt with one path per line\n");
+    printf("  output_pattern          '*' is replaced with the input name without extension\n");
+    printf("                          (\"out/*_gs.bmp\"); without '*' it is an output directory\n");
+    printf("  -queue depth            Overlap loading, filtering and saving: %d loader and %d saver\n",
+           BATCH_IO_THREADS, BATCH_IO_THREADS);
+    printf("                          threads, each image filtered by all workers, at most depth\n");
+    printf("                          images waiting between stages (bounds memory)\n");
+    printf("\nServe mode (requests are lines sent to the Unix socket):\n");
+    printf("  FILE input output [filters...]       Process files; output \"-\" returns the BMP\n");
+    printf("  DATA size output [filters...]        Process size bytes of BMP sent after the line\n");
+    printf("  STATS                                Job count, bytes and latency percentiles\n");
+    printf("  SHUTDOWN                             Stop the server\n");
+    printf("  Replies are \"OK size\" followed by size bytes, or \"ERROR message\"\n");
+    printf("\nExamples:\n");
+    printf("  image_craft input.bmp output.bmp -crop 800 600 -gs -blur 0.5\n");
+    printf("  image_craft input.bmp output.bmp -neg -vignette\n");
+    printf("  image_craft input.bmp output.bmp -crystallize -sepia\n");
+    printf("  image_craft -batch photos/ \"out/*_small.bmp\" -crop 800 600 -gs\n");
+}
+
+// Выводит профиль этапов таблицей или дописывает его в файл строками JSON
+static bool report_profile(const Profile* profile, const char* filename, const char* input) {
+    if (!profile) {
+        return true;
+    }
+    if (!filename) {
+        printf("\n");
+        profile_print(profile, stdout);
+        return true;
+    }
+
+    char* error = NULL;
+    if (!profile_write_json(profile, filename, input, &error)) {
+        fprintf(stderr, "Error writing profile: %s\n", error);
+        return false;
+    }
+    return true;
+}
+
+static int run_server(int argc, char* argv[]) {
+    FilterStep* steps = (FilterStep*)calloc(argc, sizeof(FilterStep));
+    if (!steps) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return 1;
+    }
+
+    int step_count = 0;
+    int failed_arg = -1;
+    PipelineOptions options;
+    char* error = NULL;
+    bool parsed = pipeline_parse(argc - 3, argv + 3, steps, &step_count, &options, &failed_arg, &error);
+    free(steps);
+    if (!parsed || step_count > 0 || options.bytes_mode || options.stream_mode || options.profile ||
+        options.queue_depth > 0) {
+        fprintf(stderr, "%s\n", parsed ? "Serve mode accepts only -threads and -scratch; filters are given per job"
+                                        : error);
+        return 1;
+    }
+
+    if (options.threads > 0) {
+        parallel_set_threads(options.threads);
+    }
+    if (options.scratch_dir && !image_set_scratch_directory(options.scratch_dir, &error)) {
+        fprintf(stderr, "%s\n", error);
+        return 1;
+    }
+
+    printf("Serving on %s\n", argv[2]);
+    fflush(stdout);
+    bool done = serve_run(argv[2], &error);
+    vignette_cache_clear();
+    parallel_shutdown();
+    if (!done) {
+        fprintf(stderr, "Error serving: %s\n", error);
+        return 1;
+    }
+
+    printf("Server stopped\n");
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    // Проверка аргументов командной строки
+    if (argc < 3) {
+        print_help();
+        return 0;
+    }
+
+    // Режим сервера: задания приходят через сокет, в командной строке только опции
+    if (strcmp(argv[1], "-serve") == 0 || strcmp(argv[1], "--serve") == 0) {
+        return run_server(argc, argv);
+    }
+
+    // Пакетный режим: вместо входного и выходного файлов - источник и шаблон
+    bool batch_mode = strcmp(argv[1], "-batch") == 0;
+    if (batch_mode && argc < 4) {
+        fprintf(stderr, "Batch mode requires inputs and an output pattern\n");
+        return 1;
+    }
+
+    int first_option = batch_mode ? 4 : 3;
+    const char* input_filename = argv[first_option - 2];
+    const char* output_filename = argv[first_option - 1];
+
+    // Разбираем опции и цепочку фильтров до загрузки изображения
+    FilterStep* steps = (FilterStep*)calloc(argc, sizeof(FilterStep));
+    if (!steps) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return 1;
+    }
+
+    int step_count = 0;
+    int failed_arg = -1;
+    PipelineOptions options;
+    char* error = NULL;
+    if (!pipeline_parse(argc - first_option, argv + first_option, steps, &step_count, &options,
+                        &failed_arg, &error)) {
+        if (failed_arg >= 0) {
+            fprintf(stderr, "%s: %s\n", error, argv[first_option + failed_arg] + 1);
+        }
+        else {
+            fprintf(stderr, "%s\n", error);
+        }
+        free(steps);
+        return 1;
+    }
+
+    // Число рабочих потоков
+    if (options.threads > 0) {
+        parallel_set_threads(options.threads);
+    }
+    if (options.scratch_dir && !image_set_scratch_directory(options.scratch_dir, &error)) {
+        fprintf(stderr, "%s\n", error);
+        free(steps);
+        return 1;
+    }
+    bool bytes_mode = options.bytes_mode;
+    bool stream_mode = options.stream_mode;
+
+    // Загружаем сразу в раскладке, удобной первому фильтру цепочки
+    ImageLayout layout = pipeline_layout(steps, step_count, bytes_mode);
+
+    if (stream_mode) {
+        int failed_step = stream_check(steps, step_count, &error);
+        if (failed_step >= 0) {
+            fprintf(stderr, "Filter %s cannot be streamed: %s\n", steps[failed_step].filter->name, error);
+            free(steps);
+            return 1;
+        }
+    }
+
+    if (options.queue_depth > 0 && (!batch_mode || stream_mode)) {
+        fprintf(stderr, "Option -queue requires batch mode without -stream\n");
+        free(steps);
+        return 1;
+    }
+
+    if (batch_mode && options.profile) {
+        fprintf(stderr, "Options -profile and -counters are not supported in batch mode\n");
+        free(steps);
+        return 1;
+    }
+
+    // Профиль этапов задания
+    Profile profile;
+    profile_init(&profile);
+    Profile* stage_profile = options.profile ? &profile : NULL;
+
+    // Счетчики открываются до запуска пула, чтобы их унаследовали рабочие потоки
+    if (options.counters && !profile_open_counters(&profile, &error)) {
+        fprintf(stderr, "Hardware counters unavailable: %s\n", error);
+    }
+
+    if (batch_mode) {
+        printf("Batch: %s -> %s\n", input_filename, output_filename);
+
+        BatchStats stats;
+        bool done = batch_run(input_filename, output_filename, steps, step_count, bytes_mode, stream_mode,
+                              options.queue_depth, &stats, &error);
+        free(steps);
+        vignette_cache_clear();
+        parallel_shutdown();
+        if (!done) {
+            fprintf(stderr, "Error running batch: %s\n", error);
+            return 1;
+        }
+
+        printf("Processed %d images (%d failed) in %.2f s: %.1f images/s\n", stats.total - stats.failed,
+               stats.failed, stats.seconds, stats.seconds > 0 ? (stats.total - stats.failed) / stats.seconds : 0.0);
+        return stats.failed > 0 ? 1 : 0;
+    }
+
+    // Потоковый режим: изображение целиком в память не загружается
+    if (stream_mode) {
+        printf("Streaming image: %s -> %s\n", input_filename, output_filename);
+        for (int i = 0; i < step_count; i++) {
+            printf("Applying filter: %s\n", steps[i].filter->name);
+        }
+
+        // Полосы проходят все этапы по очереди, поэтому весь поток - один этап
+        int width = 0;
+        int height = 0;
+        BmpReader reader;
+        if (stage_profile && bmp_reader_open(&reader, input_filename, NULL)) {
+            width = reader.width;
+            height = reader.height;
+            bmp_reader_close(&reader);
+        }
+        if (stage_profile) {
+            profile_begin(stage_profile);
+        }
+
+        bool done = stream_process(input_filename, output_filename, steps, step_count, layout, &error);
+        free(steps);
+        parallel_shutdown();
+        if (!done) {
+            fprintf(stderr, "Error streaming image: %s\n", error);
+            profile_free(&profile);
+            return 1;
+        }
+
+        if (stage_profile) {
+            profile_end(stage_profile, "stream", width, height);
+        }
+        printf("Done!\n");
+        bool reported = report_profile(stage_profile, options.profile_file, input_filename);
+        profile_free(&profile);
+        return reported ? 0 : 1;
+    }
+
+    printf("Loading image: %s\n", input_filename);
+
+    // Загружаем изображение
+    if (stage_profile) {
+        profile_begin(stage_profile);
+    }
+    Image* img = bmp_load_layout(input_filename, layout, &error);
+    if (!img) {
+        fprintf(stderr, "Error loading image: %s\n", error);
+        free(steps);
+        profile_free(&profile);
+        return 1;
+    }
+    if (stage_profile) {
+        profile_end(stage_profile, "load", img->width, img->height);
+    }
+
+    printf("Image loaded: %dx%d pixels\n", img->width, img->height);
+
+    // Применяем фильтры по порядку
+    int failed_step = -1;
+    if (!pipeline_apply(img, steps, step_count, true, stage_profile, &failed_step, &error)) {
+        fprintf(stderr, "Error applying filter %s: %s\n", steps[failed_step].filter->name, error);
+        image_destroy(img);
+        free(steps);
+        profile_free(&profile);
+        return 1;
+    }
+    free(steps);
+
+    // Сохраняем результат
+    printf("Saving image: %s\n", output_filename);
+    if (stage_profile) {
+        profile_begin(stage_profile);
+    }
+    if (!bmp_save(output_filename, img, &error)) {
+        fprintf(stderr, "Error saving image: %s\n", error);
+        image_destroy(img);
+        profile_free(&profile);
+        return 1;
+    }
+    if (stage_profile) {
+        profile_end(stage_profile, "save", img->width, img->height);
+    }
+
+    // Освобождаем память
+    image_destroy(img);
+    vignette_cache_clear();
+    parallel_shutdown();
+
+    printf("Done!\n");
+    bool reported = report_profile(stage_profile, options.profile_file, input_filename);
+    profile_free(&profile);
+    return reported ? 0 : 1;
 }
\ No newline at end of file
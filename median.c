@@ -0,0 +1,494 @@
+#include "median.h"
+#include "parallel.h"
+#include "simd.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NETWORK_MAX_REGISTERS (MEDIAN_NETWORK_MAX_WINDOW * MEDIAN_NETWORK_MAX_WINDOW)
+#define NETWORK_MAX_COMPARATORS 256
+#define NETWORK_BLOCK 256
+
+#define COARSE_BINS 16
+#define FINE_BINS 256
+
+// Компаратор сети: в регистре a остается минимум, в b - максимум
+typedef struct {
+    uint8_t a;
+    uint8_t b;
+    bool keep_min;
+    bool keep_max;
+} Comparator;
+
+typedef struct {
+    int count;
+    Comparator comparators[NETWORK_MAX_COMPARATORS];
+} SortingNetwork;
+
+// Задание медианы на сортирующих сетях для обработки полосы строк
+typedef struct {
+    Image* src;
+    Image* dst;
+    int radius;
+    SortingNetwork column_network;  // сортирует столбец окна
+    SortingNetwork median_network;  // выбирает медиану из отсортированных столбцов
+    int median_register;
+    bool failed;
+} NetworkMedianTask;
+
+// Гистограммы столбцов одного канала
+typedef struct {
+    uint16_t* coarse;  // [width][COARSE_BINS]
+    uint16_t* fine;    // [width][FINE_BINS]
+} ColumnHistograms;
+
+// Гистограмма окна: грубая поддерживается всегда, точная - лениво по корзинам
+typedef struct {
+    uint32_t coarse[COARSE_BINS];
+    uint32_t fine[COARSE_BINS][COARSE_BINS];
+    int fine_x[COARSE_BINS];  // позиция окна, для которой корзина актуальна
+} KernelHistogram;
+
+// Задание медианного фильтра для обработки полосы строк
+typedef struct {
+    Image* src;
+    Image* dst;
+    int radius;
+    bool failed;
+} HistogramMedianTask;
+
+static void network_add(SortingNetwork* network, int a, int b) {
+    Comparator comparator = { (uint8_t)a, (uint8_t)b, true, true };
+    network->comparators[network->count++] = comparator;
+}
+
+// Добавляет сеть Бэтчера (четно-нечетное слияние), сортирующую регистры map[0..n)
+static void network_add_sort(SortingNetwork* network, const int* map, int n) {
+    int size = 1;
+    while (size < n) size <<= 1;
+
+    for (int p = 1; p < size; p <<= 1) {
+        for (int k = p; k >= 1; k >>= 1) {
+            for (int j = k % p; j + k < size; j += 2 * k) {
+                for (int i = 0; i < k && i + j + k < n; i++) {
+                    if ((i + j) / (2 * p) == (i + j + k) / (2 * p)) {
+                        network_add(network, map[i + j], map[i + j + k]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Убирает компараторы и половины компараторов, не влияющие на регистр output
+static void network_prune(SortingNetwork* network, int output) {
+    bool live[NETWORK_MAX_REGISTERS] = { false };
+    live[output] = true;
+
+    int kept = 0;
+    for (int i = network->count - 1; i >= 0; i--) {
+        Comparator comparator = network->comparators[i];
+        comparator.keep_min = live[comparator.a];
+        comparator.keep_max = live[comparator.b];
+        if (!comparator.keep_min && !comparator.keep_max) {
+            continue;
+        }
+
+        live[comparator.a] = true;
+        live[comparator.b] = true;
+        network->comparators[NETWORK_MAX_COMPARATORS - 1 - kept] = comparator;
+        kept++;
+    }
+
+    memmove(network->comparators, &network->comparators[NETWORK_MAX_COMPARATORS - kept],
+            kept * sizeof(Comparator));
+    network->count = kept;
+}
+
+// Строит сеть медианы окна n x n, у которого столбцы уже отсортированы.
+// После сортировки строк матрица упорядочена и по строкам, и по столбцам,
+// поэтому часть элементов заведомо меньше медианы, часть - заведомо больше,
+// и медиана ищется только среди оставшихся кандидатов
+static int build_median_network(SortingNetwork* network, int n) {
+    int map[NETWORK_MAX_REGISTERS];
+    network->count = 0;
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            map[j] = i * n + j;
+        }
+        network_add_sort(network, map, n);
+    }
+
+    int median_rank = n * n / 2;
+    int below = 0;
+    int candidate_count = 0;
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            if ((n - i) * (n - j) > median_rank + 1) {
+                below++;
+            }
+            else if ((i + 1) * (j + 1) <= median_rank + 1) {
+                map[candidate_count++] = i * n + j;
+            }
+        }
+    }
+
+    network_add_sort(network, map, candidate_count);
+
+    int output = map[median_rank - below];
+    network_prune(network, output);
+    return output;
+}
+
+// Прогоняет сеть по блокам соседних пикселей; inputs[k] - начальное значение регистра k
+static void network_run(const SortingNetwork* network, const float* const* inputs,
+                        const int* output_registers, float* const* outputs, int output_count,
+                        int count, float* scratch) {
+    for (int x0 = 0; x0 < count; x0 += NETWORK_BLOCK) {
+        int length = count - x0 < NETWORK_BLOCK ? count - x0 : NETWORK_BLOCK;
+
+        const float* values[NETWORK_MAX_REGISTERS];
+        for (int k = 0; k < NETWORK_MAX_REGISTERS; k++) {
+            values[k] = inputs[k] ? inputs[k] + x0 : NULL;
+        }
+
+        for (int i = 0; i < network->count; i++) {
+            const Comparator* comparator = &network->comparators[i];
+            float* min_out = comparator->keep_min ? &scratch[comparator->a * NETWORK_BLOCK] : NULL;
+            float* max_out = comparator->keep_max ? &scratch[comparator->b * NETWORK_BLOCK] : NULL;
+
+            simd_compare_exchange(values[comparator->a], values[comparator->b], min_out, max_out, length);
+
+            if (min_out) values[comparator->a] = min_out;
+            if (max_out) values[comparator->b] = max_out;
+        }
+
+        for (int i = 0; i < output_count; i++) {
+            memcpy(outputs[i] + x0, values[output_registers[i]], length * sizeof(float));
+        }
+    }
+}
+
+// Квантует значение канала так же, как при сохранении в BMP
+static inline int quantize(float value) {
+    float clamped = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+    return (int)(clamped * 255.0f + 0.5f);
+}
+
+static inline int clamp_index(int value, int size) {
+    if (value < 0) return 0;
+    if (value >= size) return size - 1;
+    return value;
+}
+
+// Читает строку канала в float; 8-битные значения переводятся только для этой строки
+static void load_channel_row(Image* img, int channel, int y, float* values) {
+    if (img->layout == IMAGE_LAYOUT_BYTES) {
+        const uint8_t* bytes = img->bytes[y] + channel;
+        for (int x = 0; x < img->width; x++) {
+            values[x] = byte_to_unit[bytes[x * 3]];
+        }
+        return;
+    }
+    memcpy(values, image_plane_row(img, channel, y), img->width * sizeof(float));
+}
+
+// Записывает строку канала, полученную load_channel_row
+static void store_channel_row(Image* img, int channel, int y, const float* values) {
+    uint8_t* bytes = img->bytes[y] + channel;
+    for (int x = 0; x < img->width; x++) {
+        bytes[x * 3] = (uint8_t)quantize(values[x]);
+    }
+}
+
+static void network_median_rows(void* context, int y_begin, int y_end) {
+    NetworkMedianTask* task = (NetworkMedianTask*)context;
+    Image* img = task->src;
+    int width = img->width;
+    int height = img->height;
+    int radius = task->radius;
+    int n = 2 * radius + 1;
+    int padded_width = width + 2 * radius;
+
+    // Строки каналов с дополнением по краям (кольцо из n строк на канал),
+    // отсортированные столбцы и регистры сети
+    size_t plane_floats = (size_t)3 * n * padded_width;
+    size_t sorted_floats = (size_t)n * padded_width;
+    float* buffer = (float*)image_temp_alloc((plane_floats + sorted_floats + width +
+                                    NETWORK_MAX_REGISTERS * NETWORK_BLOCK) * sizeof(float));
+    if (!buffer) {
+        task->failed = true;
+        return;
+    }
+
+    float* planes = buffer;
+    float* sorted = planes + plane_floats;
+    float* scratch = sorted + sorted_floats;
+    float* result = scratch + NETWORK_MAX_REGISTERS * NETWORK_BLOCK;
+
+    int slot_row[MEDIAN_NETWORK_MAX_WINDOW];
+    for (int i = 0; i < n; i++) {
+        slot_row[i] = -1;
+    }
+
+    float* sorted_rows[MEDIAN_NETWORK_MAX_WINDOW];
+    int column_outputs[MEDIAN_NETWORK_MAX_WINDOW];
+    for (int i = 0; i < n; i++) {
+        sorted_rows[i] = sorted + (size_t)i * padded_width;
+        column_outputs[i] = i;
+    }
+
+    for (int y = y_begin; y < y_end; y++) {
+        // Подгружаем недостающие строки окна в кольцо
+        for (int dy = -radius; dy <= radius; dy++) {
+            int row = clamp_index(y + dy, height);
+            int slot = row % n;
+            if (slot_row[slot] == row) {
+                continue;
+            }
+
+            for (int channel = 0; channel < 3; channel++) {
+                float* plane = planes + ((size_t)channel * n + slot) * padded_width;
+                load_channel_row(img, channel, row, plane + radius);
+                for (int x = 0; x < radius; x++) {
+                    plane[x] = plane[radius];
+                    plane[radius + width + x] = plane[radius + width - 1];
+                }
+            }
+            slot_row[slot] = row;
+        }
+
+        for (int channel = 0; channel < 3; channel++) {
+            // Сортируем каждый столбец один раз для всех окон, которые его содержат
+            const float* inputs[NETWORK_MAX_REGISTERS] = { NULL };
+            for (int dy = -radius; dy <= radius; dy++) {
+                int slot = clamp_index(y + dy, height) % n;
+                inputs[dy + radius] = planes + ((size_t)channel * n + slot) * padded_width;
+            }
+            network_run(&task->column_network, inputs, column_outputs, sorted_rows, n,
+                        padded_width, scratch);
+
+            // Регистр (i, j) окна в позиции x - i-й элемент столбца x + j
+            for (int i = 0; i < n; i++) {
+                for (int j = 0; j < n; j++) {
+                    inputs[i * n + j] = sorted_rows[i] + j;
+                }
+            }
+            bool bytes = task->dst->layout == IMAGE_LAYOUT_BYTES;
+            float* output = bytes ? result : image_plane_row(task->dst, channel, y);
+            network_run(&task->median_network, inputs, &task->median_register, &output, 1,
+                        width, scratch);
+            if (bytes) {
+                store_channel_row(task->dst, channel, y, result);
+            }
+        }
+    }
+
+    free(buffer);
+}
+
+bool median_network(Image* src, Image* dst, int radius) {
+    int n = 2 * radius + 1;
+    if (n > MEDIAN_NETWORK_MAX_WINDOW) {
+        return false;
+    }
+
+    NetworkMedianTask* task = (NetworkMedianTask*)malloc(sizeof(NetworkMedianTask));
+    if (!task) {
+        return false;
+    }
+
+    task->src = src;
+    task->dst = dst;
+    task->radius = radius;
+    task->failed = false;
+
+    int map[MEDIAN_NETWORK_MAX_WINDOW] = { 0 };
+    for (int i = 0; i < n; i++) {
+        map[i] = i;
+    }
+    task->column_network.count = 0;
+    network_add_sort(&task->column_network, map, n);
+    task->median_register = build_median_network(&task->median_network, n);
+
+    parallel_for_rows(src->height, network_median_rows, task);
+
+    bool done = !task->failed;
+    free(task);
+    return done;
+}
+
+// Добавляет (delta = 1) или убирает (delta = -1) строку изображения из гистограмм столбцов
+static void update_columns(ColumnHistograms* columns, Image* img, int row, int delta) {
+    for (int channel = 0; channel < 3; channel++) {
+        uint16_t* coarse = columns[channel].coarse;
+        uint16_t* fine = columns[channel].fine;
+
+        // 8-битные значения уже квантованы
+        if (img->layout == IMAGE_LAYOUT_BYTES) {
+            const uint8_t* bytes = img->bytes[row] + channel;
+            for (int x = 0; x < img->width; x++) {
+                int value = bytes[x * 3];
+                coarse[x * COARSE_BINS + value / COARSE_BINS] += delta;
+                fine[x * FINE_BINS + value] += delta;
+            }
+            continue;
+        }
+
+        const float* values = image_plane_row(img, channel, row);
+        for (int x = 0; x < img->width; x++) {
+            int value = quantize(values[x]);
+            coarse[x * COARSE_BINS + value / COARSE_BINS] += delta;
+            fine[x * FINE_BINS + value] += delta;
+        }
+    }
+}
+
+// Пересчитывает точную корзину окна с центром в x с нуля
+static void rebuild_fine_bin(KernelHistogram* kernel, const ColumnHistograms* columns,
+                             int bin, int x, int radius, int width) {
+    uint32_t* target = kernel->fine[bin];
+    memset(target, 0, COARSE_BINS * sizeof(uint32_t));
+
+    for (int dx = -radius; dx <= radius; dx++) {
+        const uint16_t* source = &columns->fine[clamp_index(x + dx, width) * FINE_BINS + bin * COARSE_BINS];
+        for (int i = 0; i < COARSE_BINS; i++) {
+            target[i] += source[i];
+        }
+    }
+
+    kernel->fine_x[bin] = x;
+}
+
+// Сдвигает точную корзину окна с позиции fine_x до x
+static void advance_fine_bin(KernelHistogram* kernel, const ColumnHistograms* columns,
+                             int bin, int x, int radius, int width) {
+    uint32_t* target = kernel->fine[bin];
+
+    for (int position = kernel->fine_x[bin] + 1; position <= x; position++) {
+        const uint16_t* added = &columns->fine[clamp_index(position + radius, width) * FINE_BINS + bin * COARSE_BINS];
+        const uint16_t* removed = &columns->fine[clamp_index(position - radius - 1, width) * FINE_BINS + bin * COARSE_BINS];
+        for (int i = 0; i < COARSE_BINS; i++) {
+            target[i] += added[i] - removed[i];
+        }
+    }
+
+    kernel->fine_x[bin] = x;
+}
+
+// Находит медиану в окне с центром в x
+static int find_median(KernelHistogram* kernel, const ColumnHistograms* columns,
+                       int x, int radius, int width, uint32_t rank) {
+    uint32_t accumulated = 0;
+    int bin = 0;
+    while (accumulated + kernel->coarse[bin] <= rank) {
+        accumulated += kernel->coarse[bin];
+        bin++;
+    }
+
+    // Догоняем точную корзину: сдвигом, если это дешевле полного пересчета
+    if (kernel->fine_x[bin] < 0 || x - kernel->fine_x[bin] > 2 * radius + 1) {
+        rebuild_fine_bin(kernel, columns, bin, x, radius, width);
+    }
+    else if (kernel->fine_x[bin] != x) {
+        advance_fine_bin(kernel, columns, bin, x, radius, width);
+    }
+
+    const uint32_t* fine = kernel->fine[bin];
+    int value = 0;
+    while (accumulated + fine[value] <= rank) {
+        accumulated += fine[value];
+        value++;
+    }
+
+    return bin * COARSE_BINS + value;
+}
+
+static void histogram_median_rows(void* context, int y_begin, int y_end) {
+    HistogramMedianTask* task = (HistogramMedianTask*)context;
+    Image* img = task->src;
+    int width = img->width;
+    int height = img->height;
+    int radius = task->radius;
+    int window_size = 2 * radius + 1;
+    uint32_t rank = (uint32_t)((uint64_t)window_size * window_size / 2);
+
+    ColumnHistograms columns[3];
+    bool allocated = true;
+    for (int channel = 0; channel < 3; channel++) {
+        columns[channel].coarse = (uint16_t*)image_temp_calloc((size_t)width * COARSE_BINS, sizeof(uint16_t));
+        columns[channel].fine = (uint16_t*)image_temp_calloc((size_t)width * FINE_BINS, sizeof(uint16_t));
+        if (!columns[channel].coarse || !columns[channel].fine) {
+            allocated = false;
+        }
+    }
+
+    if (allocated) {
+        // Гистограммы столбцов для первой строки полосы
+        for (int dy = -radius; dy <= radius; dy++) {
+            update_columns(columns, img, clamp_index(y_begin + dy, height), 1);
+        }
+
+        for (int y = y_begin; y < y_end; y++) {
+            // Сдвигаем гистограммы столбцов на одну строку вниз
+            if (y > y_begin) {
+                update_columns(columns, img, clamp_index(y - radius - 1, height), -1);
+                update_columns(columns, img, clamp_index(y + radius, height), 1);
+            }
+
+            for (int channel = 0; channel < 3; channel++) {
+                KernelHistogram kernel;
+                memset(kernel.coarse, 0, sizeof(kernel.coarse));
+                for (int bin = 0; bin < COARSE_BINS; bin++) {
+                    kernel.fine_x[bin] = -1;
+                }
+
+                const uint16_t* coarse = columns[channel].coarse;
+                bool bytes = task->dst->layout == IMAGE_LAYOUT_BYTES;
+                float* output = bytes ? NULL : image_plane_row(task->dst, channel, y);
+                uint8_t* output_bytes = bytes ? task->dst->bytes[y] + channel : NULL;
+                for (int dx = -radius; dx <= radius; dx++) {
+                    const uint16_t* column = &coarse[clamp_index(dx, width) * COARSE_BINS];
+                    for (int bin = 0; bin < COARSE_BINS; bin++) {
+                        kernel.coarse[bin] += column[bin];
+                    }
+                }
+
+                for (int x = 0; x < width; x++) {
+                    // Сдвигаем грубую гистограмму окна на один столбец вправо
+                    if (x > 0) {
+                        const uint16_t* added = &coarse[clamp_index(x + radius, width) * COARSE_BINS];
+                        const uint16_t* removed = &coarse[clamp_index(x - radius - 1, width) * COARSE_BINS];
+                        for (int bin = 0; bin < COARSE_BINS; bin++) {
+                            kernel.coarse[bin] += added[bin] - removed[bin];
+                        }
+                    }
+
+                    int median = find_median(&kernel, &columns[channel], x, radius, width, rank);
+                    if (bytes) {
+                        output_bytes[x * 3] = (uint8_t)median;
+                    }
+                    else {
+                        output[x] = byte_to_unit[median];
+                    }
+                }
+            }
+        }
+    }
+    else {
+        task->failed = true;
+    }
+
+    for (int channel = 0; channel < 3; channel++) {
+        free(columns[channel].coarse);
+        free(columns[channel].fine);
+    }
+}
+
+bool median_histogram(Image* src, Image* dst, int radius) {
+    HistogramMedianTask task = { src, dst, radius, false };
+    // Гистограммы столбцов заполняются заново для каждой полосы (2 * radius + 1 строк),
+    // поэтому каждый поток получает одну полосу и заполняет их один раз
+    parallel_for_bands(src->height, histogram_median_rows, &task);
+    return !task.failed;
+}
@@ -0,0 +1,26 @@
+#ifndef MEDIAN_H
+#define MEDIAN_H
+
+#include "image.h"
+
+// Оба варианта работают с изображениями в раскладке IMAGE_LAYOUT_PLANAR
+// или IMAGE_LAYOUT_BYTES; src и dst должны быть в одной раскладке
+
+// До этого размера окна медиана считается сортирующими сетями, больше - по гистограммам
+#define MEDIAN_NETWORK_MAX_WINDOW 5
+
+// Наибольшее окно: счетчики гистограмм столбцов 16-битные
+#define MEDIAN_MAX_WINDOW 65535
+
+// Медианный фильтр на сортирующих сетях для окон до MEDIAN_NETWORK_MAX_WINDOW:
+// столбцы окна сортируются один раз и переиспользуются соседними окнами
+bool median_network(Image* src, Image* dst, int radius);
+
+// Медианный фильтр на скользящих гистограммах (Перро-Эбер): время на пиксель
+// не зависит от радиуса, значения каналов квантуются до 8 бит. Сохраненный
+// результат совпадает с точной медианой, только если -med - последний фильтр:
+// в середине цепочки квантование меняет вход следующих фильтров (например,
+// -blur 1 -med 7 -sharp отличается от точной медианы на несколько уровней)
+bool median_histogram(Image* src, Image* dst, int radius);
+
+#endif // MEDIAN_H
@@ -0,0 +1,245 @@
+#include "parallel.h"
+#include <stdlib.h>
+#include <stdbool.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#define MAX_THREADS 256
+#define BANDS_PER_THREAD 8
+
+// Запрошенное число потоков (0 - определить автоматически)
+static int requested_threads = 0;
+
+// Поток выполняет свои задания сам, не обращаясь к пулу
+static _Thread_local bool serial_thread = false;
+
+void parallel_set_thread_serial(bool serial) {
+    serial_thread = serial;
+}
+
+// Определяет число потоков по переменной окружения или числу ядер
+static int detect_thread_count(void) {
+    const char* env = getenv("IMAGE_CRAFT_THREADS");
+    if (env && atoi(env) > 0) {
+        return atoi(env);
+    }
+
+#ifndef _WIN32
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores > 0) {
+        return (int)cores;
+    }
+#endif
+
+    return 1;
+}
+
+int parallel_get_threads(void) {
+    int count = requested_threads > 0 ? requested_threads : detect_thread_count();
+    if (count > MAX_THREADS) count = MAX_THREADS;
+    return count;
+}
+
+#ifndef _WIN32
+
+// Пул рабочих потоков; вызывающий поток тоже обрабатывает полосы
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    pthread_t threads[MAX_THREADS];
+    int worker_count;
+    unsigned long generation;
+    int active_workers;
+    bool stopping;
+
+    // Текущее задание
+    RowRangeFunction function;
+    void* context;
+    int height;
+    int band_size;
+    int next_row;
+} ThreadPool;
+
+static ThreadPool pool = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .work_ready = PTHREAD_COND_INITIALIZER,
+    .work_done = PTHREAD_COND_INITIALIZER
+};
+static bool pool_started = false;
+
+// Не даёт двум заданиям одновременно занять пул
+static pthread_mutex_t submit_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Раздаёт полосы строк, пока они не закончатся (вызывается под mutex)
+static void run_bands(void) {
+    while (pool.next_row < pool.height) {
+        int y_begin = pool.next_row;
+        int y_end = y_begin + pool.band_size;
+        if (y_end > pool.height) y_end = pool.height;
+        pool.next_row = y_end;
+
+        pthread_mutex_unlock(&pool.mutex);
+        pool.function(pool.context, y_begin, y_end);
+        pthread_mutex_lock(&pool.mutex);
+    }
+}
+
+static void* worker_main(void* arg) {
+    (void)arg;
+    unsigned long seen_generation = 0;
+
+    pthread_mutex_lock(&pool.mutex);
+    for (;;) {
+        while (!pool.stopping && pool.generation == seen_generation) {
+            pthread_cond_wait(&pool.work_ready, &pool.mutex);
+        }
+        if (pool.stopping) {
+            break;
+        }
+        seen_generation = pool.generation;
+
+        run_bands();
+
+        pool.active_workers--;
+        if (pool.active_workers == 0) {
+            pthread_cond_signal(&pool.work_done);
+        }
+    }
+    pthread_mutex_unlock(&pool.mutex);
+
+    return NULL;
+}
+
+// Запускает рабочие потоки (вызывается под submit_mutex)
+static void pool_start(int worker_count) {
+    pool.stopping = false;
+    pool.worker_count = 0;
+    for (int i = 0; i < worker_count; i++) {
+        if (pthread_create(&pool.threads[i], NULL, worker_main, NULL) != 0) {
+            break;
+        }
+        pool.worker_count++;
+    }
+    pool_started = true;
+}
+
+// Останавливает рабочие потоки (вызывается под submit_mutex)
+static void pool_stop(void) {
+    if (!pool_started) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool.mutex);
+    pool.stopping = true;
+    pthread_cond_broadcast(&pool.work_ready);
+    pthread_mutex_unlock(&pool.mutex);
+
+    for (int i = 0; i < pool.worker_count; i++) {
+        pthread_join(pool.threads[i], NULL);
+    }
+
+    pool.worker_count = 0;
+    pool.generation = 0;
+    pool_started = false;
+}
+
+void parallel_set_threads(int count) {
+    pthread_mutex_lock(&submit_mutex);
+    requested_threads = count > 0 ? count : 0;
+    // Пул будет пересоздан с новым размером при следующем задании
+    pool_stop();
+    pthread_mutex_unlock(&submit_mutex);
+}
+
+// Раздает полосы по band_size строк (band_size == 0 - выбрать по числу потоков)
+static void run_parallel(int height, int band_size, RowRangeFunction function, void* context) {
+    if (height <= 0) {
+        return;
+    }
+
+    int thread_count = parallel_get_threads();
+
+    // Однопоточный режим, вложенный вызов, поток без пула или пул уже занят другим заданием
+    if (thread_count <= 1 || height == 1 || serial_thread || pthread_mutex_trylock(&submit_mutex) != 0) {
+        function(context, 0, height);
+        return;
+    }
+
+    if (!pool_started || pool.worker_count != thread_count - 1) {
+        pool_stop();
+        pool_start(thread_count - 1);
+    }
+
+    if (band_size <= 0) {
+        band_size = height / (thread_count * BANDS_PER_THREAD);
+        if (band_size < 1) band_size = 1;
+    }
+
+    pthread_mutex_lock(&pool.mutex);
+    pool.function = function;
+    pool.context = context;
+    pool.height = height;
+    pool.band_size = band_size;
+    pool.next_row = 0;
+    pool.active_workers = pool.worker_count;
+    pool.generation++;
+    pthread_cond_broadcast(&pool.work_ready);
+
+    run_bands();
+
+    while (pool.active_workers > 0) {
+        pthread_cond_wait(&pool.work_done, &pool.mutex);
+    }
+    pthread_mutex_unlock(&pool.mutex);
+
+    pthread_mutex_unlock(&submit_mutex);
+}
+
+void parallel_for_rows(int height, RowRangeFunction function, void* context) {
+    run_parallel(height, 0, function, context);
+}
+
+void parallel_for_bands(int height, RowRangeFunction function, void* context) {
+    int thread_count = parallel_get_threads();
+    run_parallel(height, (height + thread_count - 1) / thread_count, function, context);
+}
+
+void parallel_for_each(int count, RowRangeFunction function, void* context) {
+    run_parallel(count, 1, function, context);
+}
+
+void parallel_shutdown(void) {
+    pthread_mutex_lock(&submit_mutex);
+    pool_stop();
+    pthread_mutex_unlock(&submit_mutex);
+}
+
+#else
+
+// На Windows полосы обрабатываются последовательно в вызывающем потоке
+void parallel_set_threads(int count) {
+    requested_threads = count > 0 ? count : 0;
+}
+
+void parallel_for_rows(int height, RowRangeFunction function, void* context) {
+    if (height > 0) {
+        function(context, 0, height);
+    }
+}
+
+void parallel_for_bands(int height, RowRangeFunction function, void* context) {
+    parallel_for_rows(height, function, context);
+}
+
+void parallel_for_each(int count, RowRangeFunction function, void* context) {
+    parallel_for_rows(count, function, context);
+}
+
+void parallel_shutdown(void) {
+}
+
+#endif
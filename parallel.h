@@ -0,0 +1,29 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdbool.h>
+
+// Функция, обрабатывающая полосу строк [y_begin, y_end)
+typedef void (*RowRangeFunction)(void* context, int y_begin, int y_end);
+
+// Функции для работы с пулом потоков
+void parallel_set_threads(int count);
+int parallel_get_threads(void);
+void parallel_for_rows(int height, RowRangeFunction function, void* context);
+
+// Делит строки на одну непрерывную полосу на поток - для функций, у которых
+// подготовка полосы дорогая (например, заполнение гистограмм окна)
+void parallel_for_bands(int height, RowRangeFunction function, void* context);
+
+// Раздает элементы [0, count) по одному - для крупных независимых заданий
+// (например, изображений пакета). Пока задание занимает пул, вложенные вызовы
+// parallel_for_rows выполняются в вызывающем потоке
+void parallel_for_each(int count, RowRangeFunction function, void* context);
+void parallel_shutdown(void);
+
+// С serial вызовы из текущего потока выполняются в нем самом и не занимают пул:
+// так вспомогательные потоки (например, ввода-вывода пакета) не отнимают пул
+// у основной обработки
+void parallel_set_thread_serial(bool serial);
+
+#endif // PARALLEL_H
@@ -0,0 +1,186 @@
+#include "pipeline.h"
+#include "point_ops.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool pipeline_parse(int arg_count, char** args, FilterStep* steps, int* step_count,
+                    PipelineOptions* options, int* failed_arg, char** error) {
+    options->bytes_mode = false;
+    options->stream_mode = false;
+    options->threads = 0;
+    options->profile = false;
+    options->profile_file = NULL;
+    options->counters = false;
+    options->scratch_dir = NULL;
+    options->queue_depth = 0;
+    *step_count = 0;
+    *failed_arg = -1;
+
+    for (int i = 0; i < arg_count; i++) {
+        if (args[i][0] != '-') {
+            continue;
+        }
+
+        char* filter_name = args[i] + 1; // Пропускаем '-'
+
+        // Число рабочих потоков
+        if (strcmp(filter_name, "threads") == 0) {
+            if (i + 1 >= arg_count || atoi(args[i + 1]) <= 0) {
+                if (error) *error = "Option -threads requires a positive count";
+                return false;
+            }
+            options->threads = atoi(args[i + 1]);
+            i++;
+            continue;
+        }
+
+        // Глубина очередей конвейера загрузка - фильтры - сохранение
+        if (strcmp(filter_name, "queue") == 0) {
+            if (i + 1 >= arg_count || atoi(args[i + 1]) <= 0) {
+                if (error) *error = "Option -queue requires a positive depth";
+                return false;
+            }
+            options->queue_depth = atoi(args[++i]);
+            continue;
+        }
+
+        // Каталог файлов подкачки для изображений больше оперативной памяти
+        if (strcmp(filter_name, "scratch") == 0) {
+            if (i + 1 >= arg_count || args[i + 1][0] == '-') {
+                if (error) *error = "Option -scratch requires a directory";
+                return false;
+            }
+            options->scratch_dir = args[++i];
+            continue;
+        }
+
+        // Профилирование этапов: таблица на экран или строки JSON в файл;
+        // как и -serve, опции принимаются и с двумя дефисами
+        if (strcmp(filter_name, "profile") == 0 || strcmp(filter_name, "-profile") == 0) {
+            options->profile = true;
+            if (i + 1 < arg_count && args[i + 1][0] != '-') {
+                options->profile_file = args[++i];
+            }
+            continue;
+        }
+        if (strcmp(filter_name, "counters") == 0 || strcmp(filter_name, "-counters") == 0) {
+            options->profile = true;
+            options->counters = true;
+            continue;
+        }
+
+        // Формат хранения и режим обработки
+        if (strcmp(filter_name, "8bit") == 0) {
+            options->bytes_mode = true;
+            continue;
+        }
+        if (strcmp(filter_name, "stream") == 0) {
+            options->stream_mode = true;
+            continue;
+        }
+
+        // Ищем фильтр в таблице
+        Filter* filter = NULL;
+        for (int j = 0; j < filter_count; j++) {
+            if (strcmp(available_filters[j].name, filter_name) == 0) {
+                filter = &available_filters[j];
+                break;
+            }
+        }
+
+        if (!filter) {
+            *failed_arg = i;
+            if (error) *error = "Unknown filter";
+            return false;
+        }
+
+        // Подсчитываем аргументы фильтра
+        int filter_args = 0;
+        while (i + 1 + filter_args < arg_count && args[i + 1 + filter_args][0] != '-') {
+            filter_args++;
+        }
+
+        // Проверяем количество аргументов
+        if (filter_args < filter->min_args || (filter->max_args != -1 && filter_args > filter->max_args)) {
+            *failed_arg = i;
+            if (error) *error = "Invalid number of arguments for filter";
+            return false;
+        }
+
+        steps[*step_count].filter = filter;
+        steps[*step_count].argc = filter_args;
+        steps[*step_count].argv = filter_args > 0 ? &args[i + 1] : NULL;
+        (*step_count)++;
+
+        // Пропускаем обработанные аргументы
+        i += filter_args;
+    }
+
+    return true;
+}
+
+ImageLayout pipeline_layout(const FilterStep* steps, int step_count, bool bytes_mode) {
+    // С -8bit изображение остается 8-битным, пока фильтру не нужен float
+    if (bytes_mode) {
+        return IMAGE_LAYOUT_BYTES;
+    }
+    return step_count > 0 ? steps[0].filter->layout : IMAGE_LAYOUT_INTERLEAVED;
+}
+
+bool pipeline_apply(Image* img, const FilterStep* steps, int step_count, bool verbose, Profile* profile,
+                    int* failed_step, char** error) {
+    for (int i = 0; i < step_count; i++) {
+        int width = img->width;
+        int height = img->height;
+        if (profile) {
+            profile_begin(profile);
+        }
+
+        // Подряд идущие поточечные фильтры выполняются за один проход
+        int run = point_ops_run_length(&steps[i], step_count - i);
+        if (run >= 2) {
+            if (verbose) {
+                printf("Applying filters:");
+                for (int j = i; j < i + run; j++) {
+                    printf(" %s", steps[j].filter->name);
+                }
+                printf(" (fused)\n");
+            }
+
+            if (!point_ops_apply(img, &steps[i], run, error)) {
+                if (failed_step) *failed_step = i;
+                return false;
+            }
+
+            if (profile) {
+                // Слитые фильтры - один этап с именем вида "gs+sepia"
+                char name[64] = "";
+                size_t length = 0;
+                for (int j = i; j < i + run && length < sizeof(name); j++) {
+                    length += snprintf(name + length, sizeof(name) - length, "%s%s",
+                                       j > i ? "+" : "", steps[j].filter->name);
+                }
+                profile_end(profile, name, width, height);
+            }
+
+            i += run - 1;
+            continue;
+        }
+
+        if (verbose) {
+            printf("Applying filter: %s\n", steps[i].filter->name);
+        }
+
+        if (!steps[i].filter->function(img, steps[i].argc, steps[i].argv, error)) {
+            if (failed_step) *failed_step = i;
+            return false;
+        }
+
+        if (profile) {
+            profile_end(profile, steps[i].filter->name, width, height);
+        }
+    }
+
+    return true;
+}
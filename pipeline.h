@@ -0,0 +1,36 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "filters.h"
+#include "profile.h"
+
+// Опции запуска, заданные вместе с цепочкой фильтров
+typedef struct {
+    bool bytes_mode;   // -8bit
+    bool stream_mode;  // -stream
+    int threads;       // -threads N; 0, если не задано
+    bool profile;      // -profile [file.jsonl]
+    const char* profile_file;  // Файл для строк JSON или NULL - таблица на экран
+    bool counters;     // -counters: аппаратные счетчики в профиле (включает -profile)
+    const char* scratch_dir;  // -scratch dir: каталог файлов подкачки или NULL
+    int queue_depth;   // -queue N: глубина очередей конвейера пакета; 0 - без конвейера
+} PipelineOptions;
+
+// Разбирает опции и цепочку фильтров из arg_count аргументов вида "-имя [аргументы]";
+// steps должен вмещать arg_count шагов, их argv указывают в args. При ошибке
+// в фильтре в *failed_arg записывается номер его аргумента в args, иначе -1
+bool pipeline_parse(int arg_count, char** args, FilterStep* steps, int* step_count,
+                    PipelineOptions* options, int* failed_arg, char** error);
+
+// Раскладка, в которой удобно загружать изображение для цепочки: раскладка
+// первого фильтра, с bytes_mode - 8-битная
+ImageLayout pipeline_layout(const FilterStep* steps, int step_count, bool bytes_mode);
+
+// Применяет цепочку фильтров по порядку; подряд идущие поточечные фильтры
+// выполняются за один проход. С verbose печатает имена фильтров, с profile
+// записывает этап на каждый проход (profile может быть NULL).
+// При ошибке в *failed_step записывается номер шага, на котором она произошла
+bool pipeline_apply(Image* img, const FilterStep* steps, int step_count, bool verbose, Profile* profile,
+                    int* failed_step, char** error);
+
+#endif // PIPELINE_H
@@ -0,0 +1,269 @@
+#include "point_ops.h"
+#include "custom_filters.h"
+#include "parallel.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Этап прохода: out = min(factor * (M * (r, g, b, 1)), 1), где factor -
+// коэффициент маски виньетки, если она есть, а ограничение - если его требует фильтр
+typedef struct {
+    float matrix[3][4];
+    const VignetteMask* vignette;
+    bool clamp;
+} PointStage;
+
+typedef struct {
+    Image* img;
+    const PointStage* stages;
+    int stage_count;
+    bool has_vignette;
+    bool failed;
+} PointOpsTask;
+
+// Матрицы цветовых фильтров (последний столбец - сдвиг)
+static const float grayscale_matrix[3][4] = {
+    { 0.299f, 0.587f, 0.114f, 0.0f },
+    { 0.299f, 0.587f, 0.114f, 0.0f },
+    { 0.299f, 0.587f, 0.114f, 0.0f }
+};
+
+static const float negative_matrix[3][4] = {
+    { -1.0f, 0.0f, 0.0f, 1.0f },
+    { 0.0f, -1.0f, 0.0f, 1.0f },
+    { 0.0f, 0.0f, -1.0f, 1.0f }
+};
+
+static const float sepia_matrix[3][4] = {
+    { 0.393f, 0.769f, 0.189f, 0.0f },
+    { 0.349f, 0.686f, 0.168f, 0.0f },
+    { 0.272f, 0.534f, 0.131f, 0.0f }
+};
+
+static const float identity_matrix[3][4] = {
+    { 1.0f, 0.0f, 0.0f, 0.0f },
+    { 0.0f, 1.0f, 0.0f, 0.0f },
+    { 0.0f, 0.0f, 1.0f, 0.0f }
+};
+
+static bool is_point_op(const Filter* filter) {
+    return filter->function == filter_grayscale || filter->function == filter_negative ||
+           filter->function == filter_sepia || filter->function == filter_vignette;
+}
+
+int point_ops_run_length(const FilterStep* steps, int step_count) {
+    int length = 0;
+    while (length < step_count && is_point_op(steps[length].filter)) {
+        length++;
+    }
+    return length;
+}
+
+// Дописывает к этапу преобразование matrix: stage = matrix * stage
+static void stage_compose(PointStage* stage, const float matrix[3][4]) {
+    float result[3][4];
+    for (int row = 0; row < 3; row++) {
+        for (int column = 0; column < 4; column++) {
+            double sum = column == 3 ? matrix[row][3] : 0.0;
+            for (int k = 0; k < 3; k++) {
+                sum += (double)matrix[row][k] * stage->matrix[k][column];
+            }
+            result[row][column] = (float)sum;
+        }
+    }
+    memcpy(stage->matrix, result, sizeof(result));
+}
+
+static void release_stages(PointStage* stages, int stage_count) {
+    for (int s = 0; s < stage_count; s++) {
+        vignette_mask_release(stages[s].vignette);
+    }
+}
+
+// Строит этапы прохода для изображения width x height; возвращает их число или -1
+static int build_stages(const FilterStep* steps, int step_count, int width, int height,
+                        PointStage* stages, char** error) {
+    int stage_count = 0;
+    bool open = false;  // последний этап еще можно дополнять
+
+    for (int i = 0; i < step_count; i++) {
+        FilterFunction function = steps[i].filter->function;
+
+        if (!open) {
+            PointStage* stage = &stages[stage_count++];
+            memcpy(stage->matrix, identity_matrix, sizeof(identity_matrix));
+            stage->vignette = NULL;
+            stage->clamp = false;
+            open = true;
+        }
+
+        PointStage* stage = &stages[stage_count - 1];
+        if (function == filter_grayscale) {
+            stage_compose(stage, grayscale_matrix);
+        }
+        else if (function == filter_negative) {
+            stage_compose(stage, negative_matrix);
+        }
+        else if (function == filter_sepia) {
+            // Сепия ограничивает результат сверху, после нее начинается новый этап
+            stage_compose(stage, sepia_matrix);
+            stage->clamp = true;
+            open = false;
+        }
+        else {
+            // Виньетка умножает результат этапа на коэффициент и тоже ограничивает его
+            float strength;
+            float min_factor;
+            if (!vignette_parse_args(steps[i].argc, steps[i].argv, &strength, &min_factor, error)) {
+                release_stages(stages, stage_count);
+                return -1;
+            }
+
+            stage->vignette = vignette_mask_acquire(width, height, strength, min_factor);
+            if (!stage->vignette) {
+                release_stages(stages, stage_count);
+                if (error) *error = "Memory allocation failed";
+                return -1;
+            }
+            stage->clamp = true;
+            open = false;
+        }
+    }
+
+    return stage_count;
+}
+
+// Применяет этапы к count пикселям; каналы лежат с шагом step.
+// factors - строки масок виньетки по count коэффициентов для каждого этапа
+static void apply_stages(const PointOpsTask* task, float* r, float* g, float* b, int step, int count,
+                         const float* factors) {
+    for (int x = 0; x < count; x++) {
+        float red = r[x * step];
+        float green = g[x * step];
+        float blue = b[x * step];
+
+        for (int s = 0; s < task->stage_count; s++) {
+            const PointStage* stage = &task->stages[s];
+            const float (*m)[4] = stage->matrix;
+
+            float new_r = red * m[0][0] + green * m[0][1] + blue * m[0][2] + m[0][3];
+            float new_g = red * m[1][0] + green * m[1][1] + blue * m[1][2] + m[1][3];
+            float new_b = red * m[2][0] + green * m[2][1] + blue * m[2][2] + m[2][3];
+
+            if (stage->vignette) {
+                float factor = factors[(size_t)s * count + x];
+                new_r *= factor;
+                new_g *= factor;
+                new_b *= factor;
+            }
+
+            if (stage->clamp) {
+                new_r = new_r > 1.0f ? 1.0f : new_r;
+                new_g = new_g > 1.0f ? 1.0f : new_g;
+                new_b = new_b > 1.0f ? 1.0f : new_b;
+            }
+
+            red = new_r;
+            green = new_g;
+            blue = new_b;
+        }
+
+        r[x * step] = red;
+        g[x * step] = green;
+        b[x * step] = blue;
+    }
+}
+
+static void point_ops_rows(void* context, int y_begin, int y_end) {
+    PointOpsTask* task = (PointOpsTask*)context;
+    Image* img = task->img;
+    int width = img->width;
+
+    // 8-битная строка переводится в float только на время прохода
+    float* row = NULL;
+    float* factors = NULL;
+    if (img->layout == IMAGE_LAYOUT_BYTES) {
+        row = (float*)image_temp_alloc((size_t)width * 3 * sizeof(float));
+    }
+    if (task->has_vignette) {
+        factors = (float*)image_temp_alloc((size_t)task->stage_count * width * sizeof(float));
+    }
+    if ((img->layout == IMAGE_LAYOUT_BYTES && !row) || (task->has_vignette && !factors)) {
+        free(row);
+        free(factors);
+        task->failed = true;
+        return;
+    }
+
+    for (int y = y_begin; y < y_end; y++) {
+        // Строки масок разворачиваются из четвертей
+        for (int s = 0; s < task->stage_count; s++) {
+            if (task->stages[s].vignette) {
+                vignette_mask_row(task->stages[s].vignette, y, factors + (size_t)s * width);
+            }
+        }
+
+        if (img->layout == IMAGE_LAYOUT_PLANAR) {
+            apply_stages(task, image_plane_row(img, 0, y), image_plane_row(img, 1, y),
+                         image_plane_row(img, 2, y), 1, width, factors);
+        }
+        else if (img->layout == IMAGE_LAYOUT_BYTES) {
+            uint8_t* bytes = img->bytes[y];
+            for (int i = 0; i < width * 3; i++) {
+                row[i] = byte_to_unit[bytes[i]];
+            }
+
+            apply_stages(task, row, row + 1, row + 2, 3, width, factors);
+
+            for (int x = 0; x < width; x++) {
+                Pixel pixel = pixel_create(row[x * 3], row[x * 3 + 1], row[x * 3 + 2]);
+                pixel_to_bytes(pixel, &bytes[x * 3], &bytes[x * 3 + 1], &bytes[x * 3 + 2]);
+            }
+        }
+        else {
+            float* values = (float*)img->data[y];
+            apply_stages(task, values, values + 1, values + 2, 3, width, factors);
+        }
+    }
+
+    free(row);
+    free(factors);
+}
+
+bool point_ops_apply(Image* img, const FilterStep* steps, int step_count, char** error) {
+    if (!img) {
+        if (error) *error = "No image provided";
+        return false;
+    }
+
+    PointStage* stages = (PointStage*)malloc(step_count * sizeof(PointStage));
+    if (!stages) {
+        if (error) *error = "Memory allocation failed";
+        return false;
+    }
+
+    int stage_count = build_stages(steps, step_count, img->width, img->height, stages, error);
+    if (stage_count < 0) {
+        free(stages);
+        return false;
+    }
+
+    PointOpsTask task;
+    task.img = img;
+    task.stages = stages;
+    task.stage_count = stage_count;
+    task.has_vignette = false;
+    task.failed = false;
+    for (int s = 0; s < stage_count; s++) {
+        task.has_vignette = task.has_vignette || stages[s].vignette;
+    }
+
+    parallel_for_rows(img->height, point_ops_rows, &task);
+
+    release_stages(stages, stage_count);
+    free(stages);
+    if (task.failed) {
+        if (error) *error = "Memory allocation failed";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,17 @@
+#ifndef POINT_OPS_H
+#define POINT_OPS_H
+
+#include "filters.h"
+
+// Слияние поточечных фильтров (gs, neg, sepia, vignette): подряд идущие фильтры
+// выполняются за один проход по изображению. Цветовые преобразования
+// сворачиваются в одну аффинную матрицу 3x4; ограничение сверху, как у sepia
+// и vignette, разбивает цепочку на этапы внутри того же прохода
+
+// Число подряд идущих поточечных фильтров в начале steps
+int point_ops_run_length(const FilterStep* steps, int step_count);
+
+// Применяет step_count поточечных фильтров за один проход
+bool point_ops_apply(Image* img, const FilterStep* steps, int step_count, char** error);
+
+#endif // POINT_OPS_H
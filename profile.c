@@ -0,0 +1,363 @@
+#include "profile.h"
+#include "image.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+static const char* counter_names[PROFILE_COUNTER_COUNT] = {
+    "cycles", "instructions", "llc_misses", "branch_misses"
+};
+
+double profile_wall_ms(void) {
+    struct timespec now;
+#ifdef CLOCK_MONOTONIC
+    clock_gettime(CLOCK_MONOTONIC, &now);
+#else
+    timespec_get(&now, TIME_UTC);
+#endif
+    return (double)now.tv_sec * 1e3 + (double)now.tv_nsec * 1e-6;
+}
+
+double profile_cpu_ms(void) {
+#ifdef CLOCK_PROCESS_CPUTIME_ID
+    struct timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return (double)now.tv_sec * 1e3 + (double)now.tv_nsec * 1e-6;
+#else
+    return (double)clock() * 1e3 / CLOCKS_PER_SEC;
+#endif
+}
+
+// Сбрасывает пик резидентной памяти процесса, если система это позволяет (Linux).
+// Перед этим освобожденная память возвращается системе, иначе пик предыдущего
+// этапа остался бы в резидентной памяти
+void profile_reset_peak_rss(void) {
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+    FILE* file = fopen("/proc/self/clear_refs", "w");
+    if (file) {
+        fputs("5", file);
+        fclose(file);
+    }
+}
+
+// Пик резидентной памяти в килобайтах: с последнего сброса, если он поддерживается,
+// иначе за все время работы процесса
+long profile_peak_rss_kb(void) {
+    FILE* file = fopen("/proc/self/status", "r");
+    if (file) {
+        char line[256];
+        long value = -1;
+        while (fgets(line, sizeof(line), file)) {
+            if (strncmp(line, "VmHWM:", 6) == 0) {
+                value = atol(line + 6);
+                break;
+            }
+        }
+        fclose(file);
+        if (value >= 0) {
+            return value;
+        }
+    }
+
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        return usage.ru_maxrss;
+    }
+#endif
+    return 0;
+}
+
+void profile_init(Profile* profile) {
+    memset(profile, 0, sizeof(Profile));
+    for (int i = 0; i < PROFILE_COUNTER_COUNT; i++) {
+        profile->counter_fds[i] = -1;
+    }
+}
+
+void profile_free(Profile* profile) {
+#ifdef __linux__
+    for (int i = 0; i < PROFILE_COUNTER_COUNT; i++) {
+        if (profile->counter_fds[i] >= 0) {
+            close(profile->counter_fds[i]);
+        }
+    }
+#endif
+    free(profile->stages);
+    profile_init(profile);
+}
+
+#ifdef __linux__
+
+// Значение счетчика с поправкой на мультиплексирование: если ядро включало
+// счетчик не все время, результат масштабируется на долю времени работы
+static int64_t counter_read(int fd) {
+    uint64_t values[3];  // value, time_enabled, time_running
+    if (fd < 0 || read(fd, values, sizeof(values)) != (ssize_t)sizeof(values)) {
+        return -1;
+    }
+    if (values[2] == 0) {
+        return 0;
+    }
+    if (values[2] < values[1]) {
+        return (int64_t)((double)values[0] * values[1] / values[2]);
+    }
+    return (int64_t)values[0];
+}
+
+bool profile_open_counters(Profile* profile, char** error) {
+    static const uint64_t configs[PROFILE_COUNTER_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES
+    };
+
+    int opened = 0;
+    int last_errno = 0;
+    for (int i = 0; i < PROFILE_COUNTER_COUNT; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = configs[i];
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.inherit = 1;         // Потоки, созданные позже, считаются вместе с процессом
+        attr.exclude_kernel = 1;  // Доступно без прав при perf_event_paranoid <= 2
+        attr.exclude_hv = 1;
+
+        int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fd < 0) {
+            last_errno = errno;
+            continue;
+        }
+        profile->counter_fds[i] = fd;
+        opened++;
+    }
+
+    if (opened > 0) {
+        return true;
+    }
+    if (error) {
+        if (last_errno == EACCES || last_errno == EPERM) {
+            *error = "Access to performance counters denied (see /proc/sys/kernel/perf_event_paranoid)";
+        }
+        else if (last_errno == ENOSYS) {
+            *error = "perf_event_open is not available";
+        }
+        else {
+            *error = "Hardware performance counters are not supported here";
+        }
+    }
+    return false;
+}
+
+#else
+
+static int64_t counter_read(int fd) {
+    (void)fd;
+    return -1;
+}
+
+bool profile_open_counters(Profile* profile, char** error) {
+    (void)profile;
+    if (error) *error = "Hardware performance counters are supported only on Linux";
+    return false;
+}
+
+#endif
+
+static bool counters_open(const Profile* profile) {
+    for (int i = 0; i < PROFILE_COUNTER_COUNT; i++) {
+        if (profile->counter_fds[i] >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void profile_begin(Profile* profile) {
+    profile_reset_peak_rss();
+    profile->start_allocated = image_allocated_bytes();
+    profile->start_cpu_ms = profile_cpu_ms();
+    profile->start_wall_ms = profile_wall_ms();
+    for (int i = 0; i < PROFILE_COUNTER_COUNT; i++) {
+        profile->start_counters[i] = counter_read(profile->counter_fds[i]);
+    }
+}
+
+bool profile_end(Profile* profile, const char* name, int width, int height) {
+    int64_t counters[PROFILE_COUNTER_COUNT];
+    for (int i = 0; i < PROFILE_COUNTER_COUNT; i++) {
+        counters[i] = counter_read(profile->counter_fds[i]);
+    }
+    double wall_ms = profile_wall_ms();
+    double cpu_ms = profile_cpu_ms();
+
+    if (profile->count == profile->capacity) {
+        int capacity = profile->capacity > 0 ? profile->capacity * 2 : 16;
+        ProfileStage* stages = (ProfileStage*)realloc(profile->stages, capacity * sizeof(ProfileStage));
+        if (!stages) {
+            return false;
+        }
+        profile->stages = stages;
+        profile->capacity = capacity;
+    }
+
+    ProfileStage* stage = &profile->stages[profile->count++];
+    snprintf(stage->name, sizeof(stage->name), "%s", name);
+    stage->wall_ms = wall_ms - profile->start_wall_ms;
+    stage->cpu_ms = cpu_ms - profile->start_cpu_ms;
+    stage->megapixels = (double)width * height / 1e6;
+    stage->allocated_bytes = image_allocated_bytes() - profile->start_allocated;
+    stage->peak_rss_kb = profile_peak_rss_kb();
+    for (int i = 0; i < PROFILE_COUNTER_COUNT; i++) {
+        bool valid = counters[i] >= 0 && profile->start_counters[i] >= 0;
+        stage->counters[i] = valid ? counters[i] - profile->start_counters[i] : -1;
+    }
+    return true;
+}
+
+static double megapixels_per_second(const ProfileStage* stage) {
+    return stage->wall_ms > 0.0 ? stage->megapixels / (stage->wall_ms / 1e3) : 0.0;
+}
+
+// Отношение счетчика к делителю для отчета; отрицательное - нет данных
+static double counter_ratio(int64_t counter, double divisor) {
+    return counter >= 0 && divisor > 0.0 ? (double)counter / divisor : -1.0;
+}
+
+static void print_counter_columns(FILE* out, const int64_t* counters, double pixels) {
+    double values[3] = {
+        counters[PROFILE_CYCLES] > 0 ? counter_ratio(counters[PROFILE_INSTRUCTIONS], (double)counters[PROFILE_CYCLES])
+                                     : -1.0,
+        counter_ratio(counters[PROFILE_LLC_MISSES], pixels),
+        counter_ratio(counters[PROFILE_BRANCH_MISSES], pixels)
+    };
+    for (int i = 0; i < 3; i++) {
+        if (values[i] >= 0.0) {
+            fprintf(out, " %10.3f", values[i]);
+        }
+        else {
+            fprintf(out, " %10s", "-");
+        }
+    }
+}
+
+void profile_print(const Profile* profile, FILE* out) {
+    bool counters = counters_open(profile);
+    fprintf(out, "%-20s %10s %10s %9s %10s %12s", "Stage", "Wall ms", "CPU ms", "MP/s", "Alloc MB", "Peak RSS MB");
+    if (counters) {
+        fprintf(out, " %10s %10s %10s", "IPC", "LLC miss/px", "Br miss/px");
+    }
+    fprintf(out, "\n");
+
+    ProfileStage total = { "total", 0.0, 0.0, 0.0, 0, 0, { 0, 0, 0, 0 } };
+    double total_pixels = 0.0;
+    for (int i = 0; i < profile->count; i++) {
+        const ProfileStage* stage = &profile->stages[i];
+        fprintf(out, "%-20s %10.2f %10.2f %9.1f %10.1f %12.1f", stage->name, stage->wall_ms, stage->cpu_ms,
+                megapixels_per_second(stage), stage->allocated_bytes / 1048576.0, stage->peak_rss_kb / 1024.0);
+        if (counters) {
+            print_counter_columns(out, stage->counters, stage->megapixels * 1e6);
+        }
+        fprintf(out, "\n");
+
+        total.wall_ms += stage->wall_ms;
+        total.cpu_ms += stage->cpu_ms;
+        total.allocated_bytes += stage->allocated_bytes;
+        if (stage->peak_rss_kb > total.peak_rss_kb) {
+            total.peak_rss_kb = stage->peak_rss_kb;
+        }
+        for (int c = 0; c < PROFILE_COUNTER_COUNT; c++) {
+            total.counters[c] = total.counters[c] >= 0 && stage->counters[c] >= 0 ?
+                                total.counters[c] + stage->counters[c] : -1;
+        }
+        total_pixels += stage->megapixels * 1e6;
+    }
+
+    // Итоговые промахи - на пиксель, обработанный одним этапом
+    fprintf(out, "%-20s %10.2f %10.2f %9s %10.1f %12.1f", total.name, total.wall_ms, total.cpu_ms, "",
+            total.allocated_bytes / 1048576.0, total.peak_rss_kb / 1024.0);
+    if (counters) {
+        print_counter_columns(out, total.counters, total_pixels);
+    }
+    fprintf(out, "\n");
+}
+
+// Строка JSON с экранированием кавычек, обратной косой черты и управляющих символов
+static void write_json_string(FILE* out, const char* text) {
+    fputc('"', out);
+    for (const unsigned char* p = (const unsigned char*)text; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            fprintf(out, "\\%c", *p);
+        }
+        else if (*p < 0x20) {
+            fprintf(out, "\\u%04x", *p);
+        }
+        else {
+            fputc(*p, out);
+        }
+    }
+    fputc('"', out);
+}
+
+bool profile_write_json(const Profile* profile, const char* filename, const char* input, char** error) {
+    FILE* out = fopen(filename, "a");
+    if (!out) {
+        if (error) *error = "Cannot open profile file";
+        return false;
+    }
+
+    for (int i = 0; i < profile->count; i++) {
+        const ProfileStage* stage = &profile->stages[i];
+        fputs("{\"input\": ", out);
+        write_json_string(out, input);
+        fputs(", \"stage\": ", out);
+        write_json_string(out, stage->name);
+        fprintf(out, ", \"index\": %d, \"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"megapixels\": %.3f, "
+                "\"mpix_per_s\": %.2f, \"allocated_bytes\": %llu, \"peak_rss_kb\": %ld",
+                i, stage->wall_ms, stage->cpu_ms, stage->megapixels, megapixels_per_second(stage),
+                (unsigned long long)stage->allocated_bytes, stage->peak_rss_kb);
+        for (int c = 0; c < PROFILE_COUNTER_COUNT; c++) {
+            if (stage->counters[c] >= 0) {
+                fprintf(out, ", \"%s\": %lld", counter_names[c], (long long)stage->counters[c]);
+            }
+        }
+        if (stage->counters[PROFILE_CYCLES] > 0 && stage->counters[PROFILE_INSTRUCTIONS] >= 0) {
+            fprintf(out, ", \"ipc\": %.3f",
+                    (double)stage->counters[PROFILE_INSTRUCTIONS] / stage->counters[PROFILE_CYCLES]);
+        }
+        double pixels = stage->megapixels * 1e6;
+        if (pixels > 0.0 && stage->counters[PROFILE_LLC_MISSES] >= 0) {
+            fprintf(out, ", \"llc_misses_per_pixel\": %.4f", stage->counters[PROFILE_LLC_MISSES] / pixels);
+        }
+        if (pixels > 0.0 && stage->counters[PROFILE_BRANCH_MISSES] >= 0) {
+            fprintf(out, ", \"branch_misses_per_pixel\": %.4f", stage->counters[PROFILE_BRANCH_MISSES] / pixels);
+        }
+        fputs("}\n", out);
+    }
+
+    if (fclose(out) != 0) {
+        if (error) *error = "Cannot write profile file";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,63 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// Аппаратные счетчики процессора (perf_event_open, только Linux)
+typedef enum {
+    PROFILE_CYCLES,
+    PROFILE_INSTRUCTIONS,
+    PROFILE_LLC_MISSES,     // Промахи последнего уровня кэша
+    PROFILE_BRANCH_MISSES,  // Неверно предсказанные переходы
+    PROFILE_COUNTER_COUNT
+} ProfileCounter;
+
+// Замеры этапа обработки: загрузки, фильтра (или группы слитых фильтров), сохранения
+typedef struct {
+    char name[64];
+    double wall_ms;            // Монотонное время
+    double cpu_ms;             // Процессорное время всех потоков процесса
+    double megapixels;         // Размер изображения на входе этапа
+    uint64_t allocated_bytes;  // Выделено под пиксели и временные буферы фильтров за время этапа
+    long peak_rss_kb;          // Пик резидентной памяти за этап (или процесса, если сброс недоступен)
+    int64_t counters[PROFILE_COUNTER_COUNT];  // -1, если счетчик недоступен или не открыт
+} ProfileStage;
+
+// Профиль одного задания; этапы записываются парами profile_begin / profile_end
+typedef struct {
+    ProfileStage* stages;
+    int count;
+    int capacity;
+    double start_wall_ms;
+    double start_cpu_ms;
+    uint64_t start_allocated;
+    int counter_fds[PROFILE_COUNTER_COUNT];  // -1 - счетчик не открыт
+    int64_t start_counters[PROFILE_COUNTER_COUNT];
+} Profile;
+
+// Часы и память процесса
+double profile_wall_ms(void);
+double profile_cpu_ms(void);
+void profile_reset_peak_rss(void);
+long profile_peak_rss_kb(void);
+
+void profile_init(Profile* profile);
+void profile_free(Profile* profile);
+void profile_begin(Profile* profile);
+bool profile_end(Profile* profile, const char* name, int width, int height);
+
+// Открывает аппаратные счетчики для всех потоков процесса. Вызывается до запуска
+// пула потоков: рабочие потоки наследуют счетчики при создании. Возвращает false,
+// если не открылся ни один счетчик (например, в контейнере); профиль тогда
+// продолжает работать без них. Отдельные недоступные счетчики пропускаются
+bool profile_open_counters(Profile* profile, char** error);
+
+// Таблица этапов с итоговой строкой
+void profile_print(const Profile* profile, FILE* out);
+
+// Дописывает этапы в файл строками JSON (по объекту на этап)
+bool profile_write_json(const Profile* profile, const char* filename, const char* input, char** error);
+
+#endif // PROFILE_H
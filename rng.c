@@ -0,0 +1,28 @@
+#include "rng.h"
+
+#define GOLDEN_GAMMA 0x9E3779B97F4A7C15ull
+
+// Финальное перемешивание SplitMix64
+static inline uint64_t mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+void rng_seed(Rng* rng, uint64_t seed) {
+    rng->state = seed;
+}
+
+uint64_t rng_next(Rng* rng) {
+    return mix64(rng->state += GOLDEN_GAMMA);
+}
+
+int rng_below(Rng* rng, int bound) {
+    // Старшие 32 бита масштабируются умножением, без смещения от деления по модулю
+    return (int)(((rng_next(rng) >> 32) * (uint64_t)bound) >> 32);
+}
+
+uint64_t rng_hash(uint64_t seed, uint64_t counter) {
+    // Совпадает с (counter + 1)-м значением rng_next после rng_seed(seed)
+    return mix64(seed + (counter + 1) * GOLDEN_GAMMA);
+}
@@ -0,0 +1,23 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+// Генератор псевдослучайных чисел (SplitMix64): состояние хранится у вызывающего,
+// поэтому генераторы разных потоков независимы, а последовательность
+// полностью определяется зерном
+typedef struct {
+    uint64_t state;
+} Rng;
+
+void rng_seed(Rng* rng, uint64_t seed);
+uint64_t rng_next(Rng* rng);
+
+// Равномерное целое из [0, bound)
+int rng_below(Rng* rng, int bound);
+
+// Счетчиковый генератор: значение зависит только от зерна и номера, поэтому
+// шум для пикселя (x, y) можно вычислять в любом потоке и в любом порядке
+uint64_t rng_hash(uint64_t seed, uint64_t counter);
+
+#endif // RNG_H
@@ -0,0 +1,607 @@
+#include "serve.h"
+#include "pipeline.h"
+#include "stream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#define SERVE_MAX_LINE 65536
+#define SERVE_MAX_WORDS 1024
+#define SERVE_MAX_PAYLOAD ((size_t)1 << 30)
+
+// Одновременно открытых соединений; следующим отвечают "ERROR Too many connections"
+#define SERVE_MAX_CONNECTIONS 16
+
+// Соединение, по которому столько секунд не приходят и не уходят данные, закрывается
+#define SERVE_IO_TIMEOUT_SECONDS 30
+
+// Число последних заданий, по которым считаются процентили задержки
+#define SERVE_LATENCY_WINDOW 1024
+
+typedef struct {
+    unsigned long jobs;
+    unsigned long failed;
+    unsigned long long bytes_in;   // BMP, полученные в запросах
+    unsigned long long bytes_out;  // BMP, отправленные в ответах
+    double latencies[SERVE_LATENCY_WINDOW];  // Кольцо задержек в миллисекундах
+    int latency_count;
+    int latency_next;
+} ServeStats;
+
+typedef enum {
+    SLOT_FREE,
+    SLOT_RUNNING,
+    SLOT_FINISHED  // Поток соединения завершился, но еще не присоединен
+} SlotState;
+
+typedef struct ServeServer ServeServer;
+
+// Соединение с буферизованным чтением; каждое читается своим потоком,
+// буферы слота переиспользуются следующими соединениями
+typedef struct {
+    ServeServer* server;
+    SlotState state;
+    pthread_t thread;
+    int fd;
+    char buffer[8192];
+    size_t begin;
+    size_t end;
+    char line[SERVE_MAX_LINE];
+    uint8_t* payload;
+    size_t payload_capacity;
+    FilterStep steps[SERVE_MAX_WORDS];
+} Connection;
+
+struct ServeServer {
+    pthread_mutex_t job_mutex;    // Задания выполняются по одному, каждое на всем пуле
+    pthread_mutex_t stats_mutex;
+    pthread_mutex_t slot_mutex;   // Защищает state и fd соединений
+    ServeStats stats;
+    Connection* slots[SERVE_MAX_CONNECTIONS];
+};
+
+// Флаг читают потоки соединений, поэтому он атомарный (и безопасен в обработчике сигнала)
+static atomic_int stop_requested = 0;
+
+// Запись в канал будит цикл приема соединений
+static int wake_pipe[2] = { -1, -1 };
+
+static void request_stop(void) {
+    int saved_errno = errno;
+    stop_requested = 1;
+    if (wake_pipe[1] >= 0) {
+        ssize_t written = write(wake_pipe[1], "", 1);
+        (void)written;
+    }
+    errno = saved_errno;
+}
+
+static void handle_stop_signal(int signal_number) {
+    (void)signal_number;
+    request_stop();
+}
+
+static bool connection_fill(Connection* conn) {
+    for (;;) {
+        ssize_t received = recv(conn->fd, conn->buffer, sizeof(conn->buffer), 0);
+        if (received > 0) {
+            conn->begin = 0;
+            conn->end = (size_t)received;
+            return true;
+        }
+        if (received < 0 && errno == EINTR && !stop_requested) {
+            continue;
+        }
+        return false;
+    }
+}
+
+// Читает строку без '\n' (и '\r'); false - соединение закрыто или строка слишком длинная
+static bool read_line(Connection* conn) {
+    size_t length = 0;
+    for (;;) {
+        if (conn->begin == conn->end && !connection_fill(conn)) {
+            return false;
+        }
+
+        char c = conn->buffer[conn->begin++];
+        if (c == '\n') {
+            break;
+        }
+        if (length + 1 >= sizeof(conn->line)) {
+            return false;
+        }
+        conn->line[length++] = c;
+    }
+
+    if (length > 0 && conn->line[length - 1] == '\r') {
+        length--;
+    }
+    conn->line[length] = '\0';
+    return true;
+}
+
+static bool read_exact(Connection* conn, uint8_t* data, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        if (conn->begin == conn->end && !connection_fill(conn)) {
+            return false;
+        }
+
+        size_t chunk = conn->end - conn->begin;
+        if (chunk > size - done) chunk = size - done;
+        memcpy(data + done, conn->buffer + conn->begin, chunk);
+        conn->begin += chunk;
+        done += chunk;
+    }
+    return true;
+}
+
+static bool write_all(int fd, const void* data, size_t size) {
+    const char* bytes = (const char*)data;
+    while (size > 0) {
+        ssize_t sent = send(fd, bytes, size, 0);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        bytes += sent;
+        size -= (size_t)sent;
+    }
+    return true;
+}
+
+static bool send_ok(int fd, const void* data, size_t size) {
+    char header[64];
+    int length = snprintf(header, sizeof(header), "OK %zu\n", size);
+    return write_all(fd, header, (size_t)length) && (size == 0 || write_all(fd, data, size));
+}
+
+static bool send_error(int fd, const char* message) {
+    char header[512];
+    int length = snprintf(header, sizeof(header), "ERROR %s\n", message);
+    if (length >= (int)sizeof(header)) length = (int)sizeof(header) - 1;
+    return write_all(fd, header, (size_t)length);
+}
+
+// Разбивает строку на слова на месте
+static int split_words(char* line, char** words, int max_words) {
+    int count = 0;
+    char* p = line;
+    while (*p && count < max_words) {
+        while (*p == ' ' || *p == '\t') p++;
+        if (!*p) break;
+
+        words[count++] = p;
+        while (*p && *p != ' ' && *p != '\t') p++;
+        if (*p) *p++ = '\0';
+    }
+    return count;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static bool send_stats(int fd, ServeServer* server) {
+    ServeStats copy;
+    pthread_mutex_lock(&server->stats_mutex);
+    copy = server->stats;
+    pthread_mutex_unlock(&server->stats_mutex);
+    const ServeStats* stats = &copy;
+
+    double sorted[SERVE_LATENCY_WINDOW];
+    int count = stats->latency_count;
+    memcpy(sorted, stats->latencies, count * sizeof(double));
+    qsort(sorted, count, sizeof(double), compare_doubles);
+
+    // Процентиль по ближайшему рангу
+    double percentiles[3] = { 0.5, 0.9, 0.99 };
+    double values[3] = { 0.0, 0.0, 0.0 };
+    for (int i = 0; i < 3 && count > 0; i++) {
+        int rank = (int)(percentiles[i] * count + 0.999999);
+        values[i] = sorted[(rank > 0 ? rank : 1) - 1];
+    }
+
+    char text[512];
+    int length = snprintf(text, sizeof(text),
+                          "jobs %lu\nfailed %lu\nbytes_in %llu\nbytes_out %llu\n"
+                          "latency_p50_ms %.3f\nlatency_p90_ms %.3f\nlatency_p99_ms %.3f\nlatency_max_ms %.3f\n",
+                          stats->jobs, stats->failed, stats->bytes_in, stats->bytes_out,
+                          values[0], values[1], values[2], count > 0 ? sorted[count - 1] : 0.0);
+    return send_ok(fd, text, (size_t)length);
+}
+
+// Выполняет задание FILE или DATA; результат для выхода "-" возвращается в *result
+static bool run_job(Connection* conn, char** words, int word_count, const uint8_t* payload, size_t payload_size,
+                    uint8_t** result, size_t* result_size, char* message, size_t message_size) {
+    char* error = "Invalid request";
+    const char* input = words[1];
+    const char* output = words[2];
+    bool inline_output = strcmp(output, "-") == 0;
+
+    int step_count = 0;
+    int failed_arg = -1;
+    PipelineOptions options;
+    if (!pipeline_parse(word_count - 3, words + 3, conn->steps, &step_count, &options, &failed_arg, &error)) {
+        if (failed_arg >= 0) {
+            snprintf(message, message_size, "%s: %s", error, words[3 + failed_arg] + 1);
+        }
+        else {
+            snprintf(message, message_size, "%s", error);
+        }
+        return false;
+    }
+    if (options.threads > 0 || options.scratch_dir) {
+        snprintf(message, message_size, "Options -threads and -scratch are set when the server starts");
+        return false;
+    }
+    if (options.queue_depth > 0) {
+        snprintf(message, message_size, "Option -queue requires batch mode");
+        return false;
+    }
+    if (options.profile) {
+        snprintf(message, message_size, "Options -profile and -counters are not supported in serve mode; use STATS");
+        return false;
+    }
+
+    ImageLayout layout = pipeline_layout(conn->steps, step_count, options.bytes_mode);
+
+    // Потоковый режим работает только с файлами
+    if (options.stream_mode) {
+        int failed_step = stream_check(conn->steps, step_count, &error);
+        if (payload || inline_output) {
+            error = "Option -stream requires input and output files";
+        }
+        else if (failed_step < 0 && stream_process(input, output, conn->steps, step_count, layout, &error)) {
+            return true;
+        }
+        snprintf(message, message_size, "%s", error);
+        return false;
+    }
+
+    Image* img = payload ? bmp_load_memory(payload, payload_size, layout, &error)
+                         : bmp_load_layout(input, layout, &error);
+    if (!img) {
+        snprintf(message, message_size, "%s", error);
+        return false;
+    }
+
+    int failed_step = -1;
+    bool done = pipeline_apply(img, conn->steps, step_count, false, NULL, &failed_step, &error);
+    if (!done) {
+        snprintf(message, message_size, "filter %s: %s", conn->steps[failed_step].filter->name, error);
+    }
+    else if (inline_output) {
+        char* data = NULL;
+        size_t size = 0;
+        FILE* stream = open_memstream(&data, &size);
+        done = stream && bmp_save_stream(stream, img, &error);
+        if (stream && fclose(stream) != 0) {
+            done = false;
+        }
+        if (done) {
+            *result = (uint8_t*)data;
+            *result_size = size;
+        }
+        else {
+            free(data);
+            snprintf(message, message_size, "%s", stream ? error : "Memory allocation failed");
+        }
+    }
+    else if (!(done = bmp_save(output, img, &error))) {
+        snprintf(message, message_size, "%s", error);
+    }
+
+    image_destroy(img);
+    return done;
+}
+
+// Обрабатывает запросы соединения, пока клиент его не закроет
+static void serve_connection(Connection* conn) {
+    ServeServer* server = conn->server;
+    ServeStats* stats = &server->stats;
+    char* words[SERVE_MAX_WORDS];
+    char message[256];
+
+    while (!stop_requested && read_line(conn)) {
+        int word_count = split_words(conn->line, words, SERVE_MAX_WORDS);
+        if (word_count == 0) {
+            continue;
+        }
+
+        if (strcmp(words[0], "STATS") == 0) {
+            if (!send_stats(conn->fd, server)) return;
+            continue;
+        }
+        if (strcmp(words[0], "SHUTDOWN") == 0) {
+            // Ответ отправляется до остановки: она закрывает соединения
+            send_ok(conn->fd, NULL, 0);
+            request_stop();
+            return;
+        }
+
+        bool is_file = strcmp(words[0], "FILE") == 0;
+        bool is_data = strcmp(words[0], "DATA") == 0;
+        if ((!is_file && !is_data) || word_count < 3) {
+            if (!send_error(conn->fd, "Unknown request")) return;
+            continue;
+        }
+
+        double start = profile_wall_ms();
+
+        // Данные BMP читаются сразу за строкой запроса
+        const uint8_t* payload = NULL;
+        size_t payload_size = 0;
+        if (is_data) {
+            char* end = NULL;
+            unsigned long long size = strtoull(words[1], &end, 10);
+            if (*end != '\0' || size == 0 || size > SERVE_MAX_PAYLOAD) {
+                // Длина данных неизвестна, поэтому продолжить разбор потока нельзя
+                send_error(conn->fd, "Invalid data size");
+                return;
+            }
+
+            payload_size = (size_t)size;
+            if (payload_size > conn->payload_capacity) {
+                uint8_t* grown = (uint8_t*)realloc(conn->payload, payload_size);
+                if (!grown) {
+                    send_error(conn->fd, "Memory allocation failed");
+                    return;
+                }
+                conn->payload = grown;
+                conn->payload_capacity = payload_size;
+            }
+            if (!read_exact(conn, conn->payload, payload_size)) {
+                return;
+            }
+            payload = conn->payload;
+        }
+
+        // Запрос прочитан целиком; чтение и ответ идут вне блокировки,
+        // поэтому медленный клиент не задерживает задания других
+        uint8_t* result = NULL;
+        size_t result_size = 0;
+        bool done = false;
+        pthread_mutex_lock(&server->job_mutex);
+        if (stop_requested) {
+            snprintf(message, sizeof(message), "Server is shutting down");
+        }
+        else {
+            done = run_job(conn, words, word_count, payload, payload_size, &result, &result_size,
+                           message, sizeof(message));
+        }
+        pthread_mutex_unlock(&server->job_mutex);
+        bool sent = done ? send_ok(conn->fd, result, result_size) : send_error(conn->fd, message);
+        free(result);
+
+        pthread_mutex_lock(&server->stats_mutex);
+        stats->bytes_in += payload_size;
+        stats->jobs++;
+        if (!done) {
+            stats->failed++;
+        }
+        stats->bytes_out += result_size;
+        stats->latencies[stats->latency_next] = profile_wall_ms() - start;
+        stats->latency_next = (stats->latency_next + 1) % SERVE_LATENCY_WINDOW;
+        if (stats->latency_count < SERVE_LATENCY_WINDOW) {
+            stats->latency_count++;
+        }
+        pthread_mutex_unlock(&server->stats_mutex);
+
+        if (!sent) {
+            return;
+        }
+    }
+}
+
+static void* connection_main(void* arg) {
+    Connection* conn = (Connection*)arg;
+    serve_connection(conn);
+
+    ServeServer* server = conn->server;
+    pthread_mutex_lock(&server->slot_mutex);
+    close(conn->fd);
+    conn->fd = -1;
+    conn->state = SLOT_FINISHED;
+    pthread_mutex_unlock(&server->slot_mutex);
+    return NULL;
+}
+
+// Занимает свободный слот, присоединяя завершившиеся потоки; NULL - все слоты заняты
+static Connection* claim_slot(ServeServer* server) {
+    Connection* conn = NULL;
+    pthread_mutex_lock(&server->slot_mutex);
+    for (int i = 0; i < SERVE_MAX_CONNECTIONS; i++) {
+        Connection* slot = server->slots[i];
+        if (slot && slot->state == SLOT_FINISHED) {
+            pthread_join(slot->thread, NULL);
+            slot->state = SLOT_FREE;
+        }
+        if (!conn && (!slot || slot->state == SLOT_FREE)) {
+            if (!slot) {
+                slot = (Connection*)calloc(1, sizeof(Connection));
+                if (!slot) continue;
+                slot->server = server;
+                slot->fd = -1;
+                server->slots[i] = slot;
+            }
+            slot->state = SLOT_RUNNING;
+            conn = slot;
+        }
+    }
+    pthread_mutex_unlock(&server->slot_mutex);
+    return conn;
+}
+
+// Будит потоки, ждущие данных клиентов, и дожидается их завершения
+static void close_connections(ServeServer* server) {
+    bool running[SERVE_MAX_CONNECTIONS];
+    pthread_mutex_lock(&server->slot_mutex);
+    for (int i = 0; i < SERVE_MAX_CONNECTIONS; i++) {
+        Connection* slot = server->slots[i];
+        running[i] = slot && slot->state != SLOT_FREE;
+        if (slot && slot->fd >= 0) {
+            shutdown(slot->fd, SHUT_RDWR);
+        }
+    }
+    pthread_mutex_unlock(&server->slot_mutex);
+
+    for (int i = 0; i < SERVE_MAX_CONNECTIONS; i++) {
+        if (running[i]) {
+            pthread_join(server->slots[i]->thread, NULL);
+        }
+        if (server->slots[i]) {
+            free(server->slots[i]->payload);
+            free(server->slots[i]);
+        }
+    }
+}
+
+static void accept_connection(ServeServer* server, int fd) {
+    // Клиент, замолчавший посреди запроса или не читающий ответ, не держит слот вечно
+    struct timeval timeout = { SERVE_IO_TIMEOUT_SECONDS, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    Connection* conn = claim_slot(server);
+    if (!conn) {
+        send_error(fd, "Too many connections");
+        close(fd);
+        return;
+    }
+
+    conn->fd = fd;
+    conn->begin = conn->end = 0;
+    if (pthread_create(&conn->thread, NULL, connection_main, conn) != 0) {
+        send_error(fd, "Cannot start connection thread");
+        pthread_mutex_lock(&server->slot_mutex);
+        close(fd);
+        conn->fd = -1;
+        conn->state = SLOT_FREE;
+        pthread_mutex_unlock(&server->slot_mutex);
+    }
+}
+
+bool serve_run(const char* socket_path, char** error) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        if (error) *error = "Socket path is too long";
+        return false;
+    }
+    strcpy(address.sun_path, socket_path);
+
+    // Сокет, оставшийся от прошлого запуска, удаляется; другие файлы не трогаем
+    struct stat info;
+    if (stat(socket_path, &info) == 0 && S_ISSOCK(info.st_mode)) {
+        unlink(socket_path);
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        if (error) *error = "Cannot create socket";
+        return false;
+    }
+    if (bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 64) != 0) {
+        close(listener);
+        if (error) *error = "Cannot listen on socket";
+        return false;
+    }
+
+    // Прием не блокируется: клиент может отключиться между poll и accept
+    fcntl(listener, F_SETFL, fcntl(listener, F_GETFL) | O_NONBLOCK);
+
+    ServeServer* server = (ServeServer*)calloc(1, sizeof(ServeServer));
+    if (!server || pipe(wake_pipe) != 0) {
+        free(server);
+        close(listener);
+        unlink(socket_path);
+        if (error) *error = server ? "Cannot create pipe" : "Memory allocation failed";
+        return false;
+    }
+    fcntl(wake_pipe[1], F_SETFL, fcntl(wake_pipe[1], F_GETFL) | O_NONBLOCK);
+    pthread_mutex_init(&server->job_mutex, NULL);
+    pthread_mutex_init(&server->stats_mutex, NULL);
+    pthread_mutex_init(&server->slot_mutex, NULL);
+
+    // Отключившийся клиент не должен завершать сервер, а SIGINT и SIGTERM
+    // прерывают ожидание и останавливают его после текущего задания
+    signal(SIGPIPE, SIG_IGN);
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_stop_signal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    bool done = true;
+    while (!stop_requested) {
+        struct pollfd fds[2] = { { listener, POLLIN, 0 }, { wake_pipe[0], POLLIN, 0 } };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (error) *error = "Cannot accept connection";
+            done = false;
+            break;
+        }
+        if (!(fds[0].revents & POLLIN)) {
+            continue;
+        }
+
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN || errno == EWOULDBLOCK) {
+                continue;
+            }
+            if (error) *error = "Cannot accept connection";
+            done = false;
+            break;
+        }
+        accept_connection(server, fd);
+    }
+
+    stop_requested = 1;
+    close_connections(server);
+
+    pthread_mutex_destroy(&server->job_mutex);
+    pthread_mutex_destroy(&server->stats_mutex);
+    pthread_mutex_destroy(&server->slot_mutex);
+    free(server);
+    close(wake_pipe[0]);
+    close(wake_pipe[1]);
+    wake_pipe[0] = wake_pipe[1] = -1;
+    close(listener);
+    unlink(socket_path);
+    return done;
+}
+
+#else
+
+bool serve_run(const char* socket_path, char** error) {
+    (void)socket_path;
+    if (error) *error = "Serve mode is not supported on this platform";
+    return false;
+}
+
+#endif // _WIN32
@@ -0,0 +1,24 @@
+#ifndef SERVE_H
+#define SERVE_H
+
+#include <stdbool.h>
+
+// Режим сервера: процесс остается запущенным и принимает задания через Unix-сокет,
+// поэтому пул потоков, кэш масок виньетки и буферы соединения переиспользуются
+// между заданиями. Каждое соединение читается своим потоком, а задания
+// выполняются по одному и используют весь пул, поэтому медленный клиент
+// не задерживает остальных; соединение без данных дольше 30 с закрывается.
+// В одном соединении можно отправить несколько запросов.
+//
+// Запрос - строка, слова разделяются пробелами (пути без пробелов):
+//   FILE <input.bmp> <output.bmp|-> [-8bit] [-stream] [фильтры...]
+//   DATA <size> <output.bmp|-> [-8bit] [фильтры...]   и следом size байт BMP
+//   STATS                                             счетчики сервера
+//   SHUTDOWN                                          остановить сервер
+// Выход "-" означает, что BMP результата возвращается в ответе.
+// Ответ: "OK <size>\n" и следом size байт (BMP или текст STATS)
+// либо "ERROR <сообщение>\n"
+
+bool serve_run(const char* socket_path, char** error);
+
+#endif // SERVE_H
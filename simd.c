@@ -0,0 +1,612 @@
+#include "simd.h"
+#include "color.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+static int detected_level = -1;
+
+// Определяет доступный набор инструкций (можно ограничить через IMAGE_CRAFT_SIMD)
+static SimdLevel detect_level(void) {
+    SimdLevel level = SIMD_SCALAR;
+
+#ifdef SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        level = SIMD_AVX512;
+    }
+    else if (__builtin_cpu_supports("avx2")) {
+        level = SIMD_AVX2;
+    }
+    else if (__builtin_cpu_supports("sse4.1")) {
+        level = SIMD_SSE41;
+    }
+#endif
+
+    const char* env = getenv("IMAGE_CRAFT_SIMD");
+    if (env) {
+        SimdLevel limit = level;
+        if (strcmp(env, "scalar") == 0) limit = SIMD_SCALAR;
+        else if (strcmp(env, "sse4.1") == 0) limit = SIMD_SSE41;
+        else if (strcmp(env, "avx2") == 0) limit = SIMD_AVX2;
+        else if (strcmp(env, "avx512") == 0) limit = SIMD_AVX512;
+
+        if (limit < level) level = limit;
+    }
+
+    return level;
+}
+
+// Первый вызов может произойти одновременно в нескольких потоках; определение
+// дает один и тот же результат, поэтому достаточно атомарного доступа к значению
+SimdLevel simd_level(void) {
+#ifdef __GNUC__
+    int level = __atomic_load_n(&detected_level, __ATOMIC_RELAXED);
+    if (level < 0) {
+        level = (int)detect_level();
+        __atomic_store_n(&detected_level, level, __ATOMIC_RELAXED);
+    }
+    return (SimdLevel)level;
+#else
+    if (detected_level < 0) {
+        detected_level = (int)detect_level();
+    }
+    return (SimdLevel)detected_level;
+#endif
+}
+
+const char* simd_level_name(SimdLevel level) {
+    switch (level) {
+    case SIMD_SSE41: return "sse4.1";
+    case SIMD_AVX2: return "avx2";
+    case SIMD_AVX512: return "avx512";
+    default: return "scalar";
+    }
+}
+
+// Скалярная версия, также обрабатывает хвосты векторных версий
+static void weighted_sum_scalar(const float* const* taps, const float* weights, int tap_count,
+                                float* dst, int begin, int count, bool clamp) {
+    for (int i = begin; i < count; i++) {
+        float sum = 0.0f;
+        for (int k = 0; k < tap_count; k++) {
+            sum += taps[k][i] * weights[k];
+        }
+
+        if (clamp) {
+            sum = sum < 0.0f ? 0.0f : (sum > 1.0f ? 1.0f : sum);
+        }
+        dst[i] = sum;
+    }
+}
+
+static void bgr_to_rgb_scalar(const uint8_t* bgr, float* rgb, int begin, int count) {
+    for (int i = begin; i < count; i++) {
+        rgb[i * 3] = byte_to_unit[bgr[i * 3 + 2]];
+        rgb[i * 3 + 1] = byte_to_unit[bgr[i * 3 + 1]];
+        rgb[i * 3 + 2] = byte_to_unit[bgr[i * 3]];
+    }
+}
+
+static void bgr_to_planes_scalar(const uint8_t* bgr, float* r, float* g, float* b, int begin, int count) {
+    for (int i = begin; i < count; i++) {
+        r[i] = byte_to_unit[bgr[i * 3 + 2]];
+        g[i] = byte_to_unit[bgr[i * 3 + 1]];
+        b[i] = byte_to_unit[bgr[i * 3]];
+    }
+}
+
+static inline uint8_t unit_to_byte(float value) {
+    float clamped = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+    return (uint8_t)(clamped * 255.0f + 0.5f);
+}
+
+static void rgb_to_bgr_scalar(const float* rgb, uint8_t* bgr, int begin, int count) {
+    for (int i = begin; i < count; i++) {
+        bgr[i * 3] = unit_to_byte(rgb[i * 3 + 2]);
+        bgr[i * 3 + 1] = unit_to_byte(rgb[i * 3 + 1]);
+        bgr[i * 3 + 2] = unit_to_byte(rgb[i * 3]);
+    }
+}
+
+static void planes_to_bgr_scalar(const float* r, const float* g, const float* b, uint8_t* bgr,
+                                 int begin, int count) {
+    for (int i = begin; i < count; i++) {
+        bgr[i * 3] = unit_to_byte(b[i]);
+        bgr[i * 3 + 1] = unit_to_byte(g[i]);
+        bgr[i * 3 + 2] = unit_to_byte(r[i]);
+    }
+}
+
+static void compare_exchange_scalar(const float* a, const float* b, float* min_out, float* max_out,
+                                    int begin, int count) {
+    for (int i = begin; i < count; i++) {
+        float x = a[i];
+        float y = b[i];
+        if (min_out) min_out[i] = x < y ? x : y;
+        if (max_out) max_out[i] = x > y ? x : y;
+    }
+}
+
+// Значение Собеля для столбца x; столбцы left и right уже ограничены краями строки
+static inline float sobel_pixel(const float* above, const float* row, const float* below,
+                                int left, int x, int right, float threshold_squared) {
+    // Вертикальные проходы: сглаживание для gx и разность для gy
+    float smooth_left = above[left] + 2.0f * row[left] + below[left];
+    float smooth_right = above[right] + 2.0f * row[right] + below[right];
+    float diff_left = above[left] - below[left];
+    float diff_center = above[x] - below[x];
+    float diff_right = above[right] - below[right];
+
+    float grad_x = smooth_left - smooth_right;
+    float grad_y = diff_left + 2.0f * diff_center + diff_right;
+    return grad_x * grad_x + grad_y * grad_y > threshold_squared ? 1.0f : 0.0f;
+}
+
+// Считает столбцы [begin, end) строки ширины count
+static void sobel_threshold_scalar(const float* above, const float* row, const float* below,
+                                   float* dst, int begin, int end, int count, float threshold_squared) {
+    for (int x = begin; x < end; x++) {
+        int left = x > 0 ? x - 1 : 0;
+        int right = x + 1 < count ? x + 1 : count - 1;
+        dst[x] = sobel_pixel(above, row, below, left, x, right, threshold_squared);
+    }
+}
+
+#ifdef SIMD_X86
+
+// Умножение и сложение выполняются раздельно (без FMA), чтобы результат
+// совпадал со скалярной версией бит в бит; AVX-512 включает FMA, поэтому
+// для него слияние операций запрещено явно
+
+__attribute__((target("sse4.1")))
+static void weighted_sum_sse41(const float* const* taps, const float* weights, int tap_count,
+                               float* dst, int count, bool clamp) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    int i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 sum = zero;
+        for (int k = 0; k < tap_count; k++) {
+            __m128 value = _mm_loadu_ps(taps[k] + i);
+            sum = _mm_add_ps(sum, _mm_mul_ps(value, _mm_set1_ps(weights[k])));
+        }
+
+        if (clamp) {
+            sum = _mm_min_ps(_mm_max_ps(sum, zero), one);
+        }
+        _mm_storeu_ps(dst + i, sum);
+    }
+
+    weighted_sum_scalar(taps, weights, tap_count, dst, i, count, clamp);
+}
+
+__attribute__((target("avx2")))
+static void weighted_sum_avx2(const float* const* taps, const float* weights, int tap_count,
+                              float* dst, int count, bool clamp) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    int i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256 sum = zero;
+        for (int k = 0; k < tap_count; k++) {
+            __m256 value = _mm256_loadu_ps(taps[k] + i);
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(value, _mm256_set1_ps(weights[k])));
+        }
+
+        if (clamp) {
+            sum = _mm256_min_ps(_mm256_max_ps(sum, zero), one);
+        }
+        _mm256_storeu_ps(dst + i, sum);
+    }
+
+    weighted_sum_scalar(taps, weights, tap_count, dst, i, count, clamp);
+}
+
+__attribute__((target("avx512f"), optimize("fp-contract=off")))
+static void weighted_sum_avx512(const float* const* taps, const float* weights, int tap_count,
+                                float* dst, int count, bool clamp) {
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512 one = _mm512_set1_ps(1.0f);
+    int i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m512 sum = zero;
+        for (int k = 0; k < tap_count; k++) {
+            __m512 value = _mm512_loadu_ps(taps[k] + i);
+            sum = _mm512_add_ps(sum, _mm512_mul_ps(value, _mm512_set1_ps(weights[k])));
+        }
+
+        if (clamp) {
+            sum = _mm512_min_ps(_mm512_max_ps(sum, zero), one);
+        }
+        _mm512_storeu_ps(dst + i, sum);
+    }
+
+    weighted_sum_scalar(taps, weights, tap_count, dst, i, count, clamp);
+}
+
+__attribute__((target("sse4.1")))
+static void compare_exchange_sse41(const float* a, const float* b, float* min_out, float* max_out, int count) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(a + i);
+        __m128 y = _mm_loadu_ps(b + i);
+        if (min_out) _mm_storeu_ps(min_out + i, _mm_min_ps(x, y));
+        if (max_out) _mm_storeu_ps(max_out + i, _mm_max_ps(x, y));
+    }
+
+    compare_exchange_scalar(a, b, min_out, max_out, i, count);
+}
+
+__attribute__((target("avx2")))
+static void compare_exchange_avx2(const float* a, const float* b, float* min_out, float* max_out, int count) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_loadu_ps(a + i);
+        __m256 y = _mm256_loadu_ps(b + i);
+        if (min_out) _mm256_storeu_ps(min_out + i, _mm256_min_ps(x, y));
+        if (max_out) _mm256_storeu_ps(max_out + i, _mm256_max_ps(x, y));
+    }
+
+    compare_exchange_scalar(a, b, min_out, max_out, i, count);
+}
+
+__attribute__((target("avx512f")))
+static void compare_exchange_avx512(const float* a, const float* b, float* min_out, float* max_out, int count) {
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512 x = _mm512_loadu_ps(a + i);
+        __m512 y = _mm512_loadu_ps(b + i);
+        if (min_out) _mm512_storeu_ps(min_out + i, _mm512_min_ps(x, y));
+        if (max_out) _mm512_storeu_ps(max_out + i, _mm512_max_ps(x, y));
+    }
+
+    compare_exchange_scalar(a, b, min_out, max_out, i, count);
+}
+
+// Векторные версии Собеля считают внутренние столбцы [1, count - 1) в том же
+// порядке операций, что и sobel_pixel; края и хвост досчитываются скалярно
+__attribute__((target("sse4.1")))
+static void sobel_threshold_sse41(const float* above, const float* row, const float* below,
+                                  float* dst, int count, float threshold_squared) {
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 limit = _mm_set1_ps(threshold_squared);
+    int x = 1;
+
+    sobel_threshold_scalar(above, row, below, dst, 0, count < 1 ? count : 1, count, threshold_squared);
+    for (; x + 4 < count; x += 4) {
+        __m128 above_left = _mm_loadu_ps(above + x - 1);
+        __m128 above_right = _mm_loadu_ps(above + x + 1);
+        __m128 below_left = _mm_loadu_ps(below + x - 1);
+        __m128 below_right = _mm_loadu_ps(below + x + 1);
+
+        __m128 smooth_left = _mm_add_ps(_mm_add_ps(above_left, _mm_mul_ps(two, _mm_loadu_ps(row + x - 1))), below_left);
+        __m128 smooth_right = _mm_add_ps(_mm_add_ps(above_right, _mm_mul_ps(two, _mm_loadu_ps(row + x + 1))), below_right);
+        __m128 diff_left = _mm_sub_ps(above_left, below_left);
+        __m128 diff_center = _mm_sub_ps(_mm_loadu_ps(above + x), _mm_loadu_ps(below + x));
+        __m128 diff_right = _mm_sub_ps(above_right, below_right);
+
+        __m128 grad_x = _mm_sub_ps(smooth_left, smooth_right);
+        __m128 grad_y = _mm_add_ps(_mm_add_ps(diff_left, _mm_mul_ps(two, diff_center)), diff_right);
+        __m128 magnitude = _mm_add_ps(_mm_mul_ps(grad_x, grad_x), _mm_mul_ps(grad_y, grad_y));
+        _mm_storeu_ps(dst + x, _mm_and_ps(_mm_cmpgt_ps(magnitude, limit), one));
+    }
+
+    sobel_threshold_scalar(above, row, below, dst, x, count, count, threshold_squared);
+}
+
+__attribute__((target("avx2")))
+static void sobel_threshold_avx2(const float* above, const float* row, const float* below,
+                                 float* dst, int count, float threshold_squared) {
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 limit = _mm256_set1_ps(threshold_squared);
+    int x = 1;
+
+    sobel_threshold_scalar(above, row, below, dst, 0, count < 1 ? count : 1, count, threshold_squared);
+    for (; x + 8 < count; x += 8) {
+        __m256 above_left = _mm256_loadu_ps(above + x - 1);
+        __m256 above_right = _mm256_loadu_ps(above + x + 1);
+        __m256 below_left = _mm256_loadu_ps(below + x - 1);
+        __m256 below_right = _mm256_loadu_ps(below + x + 1);
+
+        __m256 smooth_left = _mm256_add_ps(_mm256_add_ps(above_left, _mm256_mul_ps(two, _mm256_loadu_ps(row + x - 1))),
+                                           below_left);
+        __m256 smooth_right = _mm256_add_ps(_mm256_add_ps(above_right, _mm256_mul_ps(two, _mm256_loadu_ps(row + x + 1))),
+                                            below_right);
+        __m256 diff_left = _mm256_sub_ps(above_left, below_left);
+        __m256 diff_center = _mm256_sub_ps(_mm256_loadu_ps(above + x), _mm256_loadu_ps(below + x));
+        __m256 diff_right = _mm256_sub_ps(above_right, below_right);
+
+        __m256 grad_x = _mm256_sub_ps(smooth_left, smooth_right);
+        __m256 grad_y = _mm256_add_ps(_mm256_add_ps(diff_left, _mm256_mul_ps(two, diff_center)), diff_right);
+        __m256 magnitude = _mm256_add_ps(_mm256_mul_ps(grad_x, grad_x), _mm256_mul_ps(grad_y, grad_y));
+        _mm256_storeu_ps(dst + x, _mm256_and_ps(_mm256_cmp_ps(magnitude, limit, _CMP_GT_OQ), one));
+    }
+
+    sobel_threshold_scalar(above, row, below, dst, x, count, count, threshold_squared);
+}
+
+__attribute__((target("avx512f"), optimize("fp-contract=off")))
+static void sobel_threshold_avx512(const float* above, const float* row, const float* below,
+                                   float* dst, int count, float threshold_squared) {
+    const __m512 two = _mm512_set1_ps(2.0f);
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 limit = _mm512_set1_ps(threshold_squared);
+    int x = 1;
+
+    sobel_threshold_scalar(above, row, below, dst, 0, count < 1 ? count : 1, count, threshold_squared);
+    for (; x + 16 < count; x += 16) {
+        __m512 above_left = _mm512_loadu_ps(above + x - 1);
+        __m512 above_right = _mm512_loadu_ps(above + x + 1);
+        __m512 below_left = _mm512_loadu_ps(below + x - 1);
+        __m512 below_right = _mm512_loadu_ps(below + x + 1);
+
+        __m512 smooth_left = _mm512_add_ps(_mm512_add_ps(above_left, _mm512_mul_ps(two, _mm512_loadu_ps(row + x - 1))),
+                                           below_left);
+        __m512 smooth_right = _mm512_add_ps(_mm512_add_ps(above_right, _mm512_mul_ps(two, _mm512_loadu_ps(row + x + 1))),
+                                            below_right);
+        __m512 diff_left = _mm512_sub_ps(above_left, below_left);
+        __m512 diff_center = _mm512_sub_ps(_mm512_loadu_ps(above + x), _mm512_loadu_ps(below + x));
+        __m512 diff_right = _mm512_sub_ps(above_right, below_right);
+
+        __m512 grad_x = _mm512_sub_ps(smooth_left, smooth_right);
+        __m512 grad_y = _mm512_add_ps(_mm512_add_ps(diff_left, _mm512_mul_ps(two, diff_center)), diff_right);
+        __m512 magnitude = _mm512_add_ps(_mm512_mul_ps(grad_x, grad_x), _mm512_mul_ps(grad_y, grad_y));
+        __mmask16 edge = _mm512_cmp_ps_mask(magnitude, limit, _CMP_GT_OQ);
+        _mm512_storeu_ps(dst + x, _mm512_maskz_mov_ps(edge, one));
+    }
+
+    sobel_threshold_scalar(above, row, below, dst, x, count, count, threshold_squared);
+}
+
+// Перестановка байтов четырех пикселей BGR в 32-битные слова; деление на 255
+// (а не умножение на обратное) дает тот же результат, что и скалярная версия
+#define BGR_WORDS(a, b, c, d) a, -1, -1, -1, b, -1, -1, -1, c, -1, -1, -1, d, -1, -1, -1
+
+__attribute__((target("sse4.1")))
+static inline __m128 bytes_to_unit_sse41(__m128i bytes, __m128i mask) {
+    return _mm_div_ps(_mm_cvtepi32_ps(_mm_shuffle_epi8(bytes, mask)), _mm_set1_ps(255.0f));
+}
+
+__attribute__((target("sse4.1")))
+static void bgr_to_rgb_sse41(const uint8_t* bgr, float* rgb, int count) {
+    const __m128i mask0 = _mm_setr_epi8(BGR_WORDS(2, 1, 0, 5));
+    const __m128i mask1 = _mm_setr_epi8(BGR_WORDS(4, 3, 8, 7));
+    const __m128i mask2 = _mm_setr_epi8(BGR_WORDS(6, 11, 10, 9));
+    int i = 0;
+
+    // Загружается 16 байт, из которых используются 12
+    for (; (i + 4) * 3 + 4 <= count * 3; i += 4) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(bgr + i * 3));
+        _mm_storeu_ps(rgb + i * 3, bytes_to_unit_sse41(bytes, mask0));
+        _mm_storeu_ps(rgb + i * 3 + 4, bytes_to_unit_sse41(bytes, mask1));
+        _mm_storeu_ps(rgb + i * 3 + 8, bytes_to_unit_sse41(bytes, mask2));
+    }
+
+    bgr_to_rgb_scalar(bgr, rgb, i, count);
+}
+
+__attribute__((target("sse4.1")))
+static void bgr_to_planes_sse41(const uint8_t* bgr, float* r, float* g, float* b, int count) {
+    const __m128i mask_r = _mm_setr_epi8(BGR_WORDS(2, 5, 8, 11));
+    const __m128i mask_g = _mm_setr_epi8(BGR_WORDS(1, 4, 7, 10));
+    const __m128i mask_b = _mm_setr_epi8(BGR_WORDS(0, 3, 6, 9));
+    int i = 0;
+
+    for (; (i + 4) * 3 + 4 <= count * 3; i += 4) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(bgr + i * 3));
+        _mm_storeu_ps(r + i, bytes_to_unit_sse41(bytes, mask_r));
+        _mm_storeu_ps(g + i, bytes_to_unit_sse41(bytes, mask_g));
+        _mm_storeu_ps(b + i, bytes_to_unit_sse41(bytes, mask_b));
+    }
+
+    bgr_to_planes_scalar(bgr, r, g, b, i, count);
+}
+
+// Ограничение, масштабирование и округление отбрасыванием дробной части,
+// как в pixel_to_bytes (умножение и сложение раздельно)
+__attribute__((target("sse4.1")))
+static inline __m128i unit_to_bytes_sse41(__m128 values) {
+    __m128 clamped = _mm_min_ps(_mm_max_ps(values, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(clamped, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+}
+
+__attribute__((target("sse4.1")))
+static void rgb_to_bgr_sse41(const float* rgb, uint8_t* bgr, int count) {
+    // После упаковки байты идут как r0 g0 b0 r1 ... b3, переставляем в BGR
+    const __m128i order = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, -1, -1, -1, -1);
+    int i = 0;
+
+    // Записывается 16 байт, последние 4 перезаписываются следующими пикселями
+    for (; (i + 4) * 3 + 4 <= count * 3; i += 4) {
+        __m128i v0 = unit_to_bytes_sse41(_mm_loadu_ps(rgb + i * 3));
+        __m128i v1 = unit_to_bytes_sse41(_mm_loadu_ps(rgb + i * 3 + 4));
+        __m128i v2 = unit_to_bytes_sse41(_mm_loadu_ps(rgb + i * 3 + 8));
+        __m128i words = _mm_packus_epi32(v0, v1);
+        __m128i bytes = _mm_packus_epi16(words, _mm_packus_epi32(v2, v2));
+        _mm_storeu_si128((__m128i*)(bgr + i * 3), _mm_shuffle_epi8(bytes, order));
+    }
+
+    rgb_to_bgr_scalar(rgb, bgr, i, count);
+}
+
+__attribute__((target("sse4.1")))
+static void planes_to_bgr_sse41(const float* r, const float* g, const float* b, uint8_t* bgr, int count) {
+    // После упаковки байты идут как r0..r3 g0..g3 b0..b3
+    const __m128i order = _mm_setr_epi8(8, 4, 0, 9, 5, 1, 10, 6, 2, 11, 7, 3, -1, -1, -1, -1);
+    int i = 0;
+
+    for (; (i + 4) * 3 + 4 <= count * 3; i += 4) {
+        __m128i red = unit_to_bytes_sse41(_mm_loadu_ps(r + i));
+        __m128i green = unit_to_bytes_sse41(_mm_loadu_ps(g + i));
+        __m128i blue = unit_to_bytes_sse41(_mm_loadu_ps(b + i));
+        __m128i words = _mm_packus_epi32(red, green);
+        __m128i bytes = _mm_packus_epi16(words, _mm_packus_epi32(blue, blue));
+        _mm_storeu_si128((__m128i*)(bgr + i * 3), _mm_shuffle_epi8(bytes, order));
+    }
+
+    planes_to_bgr_scalar(r, g, b, bgr, i, count);
+}
+
+// В AVX2 каждая 128-битная половина регистра обрабатывает свои четыре пикселя
+__attribute__((target("avx2")))
+static inline __m256i load_bgr_avx2(const uint8_t* bgr) {
+    __m128i low = _mm_loadu_si128((const __m128i*)bgr);
+    __m128i high = _mm_loadu_si128((const __m128i*)(bgr + 12));
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+}
+
+__attribute__((target("avx2")))
+static inline __m256 bytes_to_unit_avx2(__m256i bytes, __m256i mask) {
+    return _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_shuffle_epi8(bytes, mask)), _mm256_set1_ps(255.0f));
+}
+
+__attribute__((target("avx2")))
+static void bgr_to_planes_avx2(const uint8_t* bgr, float* r, float* g, float* b, int count) {
+    const __m256i mask_r = _mm256_setr_epi8(BGR_WORDS(2, 5, 8, 11), BGR_WORDS(2, 5, 8, 11));
+    const __m256i mask_g = _mm256_setr_epi8(BGR_WORDS(1, 4, 7, 10), BGR_WORDS(1, 4, 7, 10));
+    const __m256i mask_b = _mm256_setr_epi8(BGR_WORDS(0, 3, 6, 9), BGR_WORDS(0, 3, 6, 9));
+    int i = 0;
+
+    for (; (i + 8) * 3 + 4 <= count * 3; i += 8) {
+        __m256i bytes = load_bgr_avx2(bgr + i * 3);
+        _mm256_storeu_ps(r + i, bytes_to_unit_avx2(bytes, mask_r));
+        _mm256_storeu_ps(g + i, bytes_to_unit_avx2(bytes, mask_g));
+        _mm256_storeu_ps(b + i, bytes_to_unit_avx2(bytes, mask_b));
+    }
+
+    bgr_to_planes_sse41(bgr + i * 3, r + i, g + i, b + i, count - i);
+}
+
+#endif // SIMD_X86
+
+void simd_bgr_to_rgb(const uint8_t* bgr, float* rgb, int count) {
+    switch (simd_level()) {
+#ifdef SIMD_X86
+    case SIMD_AVX512:
+    case SIMD_AVX2:
+    case SIMD_SSE41:
+        // Для чередующегося выхода хватает 128-битной перестановки
+        bgr_to_rgb_sse41(bgr, rgb, count);
+        return;
+#endif
+    default:
+        bgr_to_rgb_scalar(bgr, rgb, 0, count);
+        return;
+    }
+}
+
+void simd_bgr_to_planes(const uint8_t* bgr, float* r, float* g, float* b, int count) {
+    switch (simd_level()) {
+#ifdef SIMD_X86
+    case SIMD_AVX512:
+    case SIMD_AVX2:
+        bgr_to_planes_avx2(bgr, r, g, b, count);
+        return;
+    case SIMD_SSE41:
+        bgr_to_planes_sse41(bgr, r, g, b, count);
+        return;
+#endif
+    default:
+        bgr_to_planes_scalar(bgr, r, g, b, 0, count);
+        return;
+    }
+}
+
+void simd_rgb_to_bgr(const float* rgb, uint8_t* bgr, int count) {
+    switch (simd_level()) {
+#ifdef SIMD_X86
+    case SIMD_AVX512:
+    case SIMD_AVX2:
+    case SIMD_SSE41:
+        rgb_to_bgr_sse41(rgb, bgr, count);
+        return;
+#endif
+    default:
+        rgb_to_bgr_scalar(rgb, bgr, 0, count);
+        return;
+    }
+}
+
+void simd_planes_to_bgr(const float* r, const float* g, const float* b, uint8_t* bgr, int count) {
+    switch (simd_level()) {
+#ifdef SIMD_X86
+    case SIMD_AVX512:
+    case SIMD_AVX2:
+    case SIMD_SSE41:
+        planes_to_bgr_sse41(r, g, b, bgr, count);
+        return;
+#endif
+    default:
+        planes_to_bgr_scalar(r, g, b, bgr, 0, count);
+        return;
+    }
+}
+
+void simd_weighted_sum(const float* const* taps, const float* weights, int tap_count,
+                       float* dst, int count, bool clamp) {
+    switch (simd_level()) {
+#ifdef SIMD_X86
+    case SIMD_AVX512:
+        weighted_sum_avx512(taps, weights, tap_count, dst, count, clamp);
+        return;
+    case SIMD_AVX2:
+        weighted_sum_avx2(taps, weights, tap_count, dst, count, clamp);
+        return;
+    case SIMD_SSE41:
+        weighted_sum_sse41(taps, weights, tap_count, dst, count, clamp);
+        return;
+#endif
+    default:
+        weighted_sum_scalar(taps, weights, tap_count, dst, 0, count, clamp);
+        return;
+    }
+}
+
+void simd_sobel_threshold(const float* above, const float* row, const float* below,
+                          float* dst, int count, float threshold_squared) {
+    switch (simd_level()) {
+#ifdef SIMD_X86
+    case SIMD_AVX512:
+        sobel_threshold_avx512(above, row, below, dst, count, threshold_squared);
+        return;
+    case SIMD_AVX2:
+        sobel_threshold_avx2(above, row, below, dst, count, threshold_squared);
+        return;
+    case SIMD_SSE41:
+        sobel_threshold_sse41(above, row, below, dst, count, threshold_squared);
+        return;
+#endif
+    default:
+        sobel_threshold_scalar(above, row, below, dst, 0, count, count, threshold_squared);
+        return;
+    }
+}
+
+void simd_compare_exchange(const float* a, const float* b, float* min_out, float* max_out, int count) {
+    switch (simd_level()) {
+#ifdef SIMD_X86
+    case SIMD_AVX512:
+        compare_exchange_avx512(a, b, min_out, max_out, count);
+        return;
+    case SIMD_AVX2:
+        compare_exchange_avx2(a, b, min_out, max_out, count);
+        return;
+    case SIMD_SSE41:
+        compare_exchange_sse41(a, b, min_out, max_out, count);
+        return;
+#endif
+    default:
+        compare_exchange_scalar(a, b, min_out, max_out, 0, count);
+        return;
+    }
+}
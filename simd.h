@@ -0,0 +1,43 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Уровни векторных инструкций, выбираемые во время выполнения
+typedef enum {
+    SIMD_SCALAR,
+    SIMD_SSE41,
+    SIMD_AVX2,
+    SIMD_AVX512
+} SimdLevel;
+
+// Функции для выбора реализации
+SimdLevel simd_level(void);
+const char* simd_level_name(SimdLevel level);
+
+// Взвешенная сумма строк: dst[i] = sum(weights[k] * taps[k][i]),
+// слагаемые складываются в порядке k, как в скалярной версии
+void simd_weighted_sum(const float* const* taps, const float* weights, int tap_count,
+                       float* dst, int count, bool clamp);
+
+// Поэлементный компаратор: min_out[i] = min(a[i], b[i]), max_out[i] = max(a[i], b[i]);
+// любой из выходов может быть NULL, выходы могут совпадать со входами
+void simd_compare_exchange(const float* a, const float* b, float* min_out, float* max_out, int count);
+
+// Порог модуля градиента Собеля по трем соседним строкам яркости: dst[i] = 1, если
+// gx^2 + gy^2 > threshold_squared, иначе 0. Соседние столбцы за краем строки
+// заменяются крайним; фильтр разделимый: сглаживание [1 2 1] и разность [1 0 -1]
+void simd_sobel_threshold(const float* above, const float* row, const float* below,
+                          float* dst, int count, float threshold_squared);
+
+// Перевод count пикселей строки BMP (b, g, r по байту) в float, как pixel_from_bytes:
+// в чередующуюся строку (r, g, b) или в три плоскости
+void simd_bgr_to_rgb(const uint8_t* bgr, float* rgb, int count);
+void simd_bgr_to_planes(const uint8_t* bgr, float* r, float* g, float* b, int count);
+
+// Обратный перевод с ограничением [0, 1] и округлением, как pixel_to_bytes
+void simd_rgb_to_bgr(const float* rgb, uint8_t* bgr, int count);
+void simd_planes_to_bgr(const float* r, const float* g, const float* b, uint8_t* bgr, int count);
+
+#endif // SIMD_H
@@ -0,0 +1,145 @@
+#include "stream.h"
+#include "pipeline.h"
+#include <stdlib.h>
+#include <string.h>
+
+int stream_check(const FilterStep* steps, int step_count, char** error) {
+    bool cropping = true;
+    for (int i = 0; i < step_count; i++) {
+        const Filter* filter = steps[i].filter;
+
+        if (filter->function == filter_crop) {
+            if (!cropping) {
+                if (error) *error = "Crop must precede other filters in stream mode";
+                return i;
+            }
+            continue;
+        }
+        cropping = false;
+
+        if (!filter->halo) {
+            if (error) *error = "Filter needs the whole image and cannot be streamed";
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool stream_process(const char* input_filename, const char* output_filename, const FilterStep* steps,
+                    int step_count, ImageLayout layout, char** error) {
+    if (stream_check(steps, step_count, error) >= 0) {
+        return false;
+    }
+
+    BmpReader reader;
+    if (!bmp_reader_open(&reader, input_filename, error)) {
+        return false;
+    }
+
+    // Обрезка сводится к чтению части строк и столбцов начиная с (origin_x, origin_y)
+    int origin_x = 0;
+    int origin_y = 0;
+    int width = reader.width;
+    int height = reader.height;
+    int first = 0;
+    for (; first < step_count && steps[first].filter->function == filter_crop; first++) {
+        const FilterStep* step = &steps[first];
+        int crop_width = atoi(step->argv[0]);
+        int crop_height = atoi(step->argv[1]);
+        int x = step->argc >= 4 ? atoi(step->argv[2]) : 0;
+        int y = step->argc >= 4 ? atoi(step->argv[3]) : 0;
+        if (crop_width <= 0 || crop_height <= 0 || step->argc == 3 ||
+            x < 0 || y < 0 || x >= width || y >= height) {
+            bmp_reader_close(&reader);
+            if (error) *error = "Invalid crop parameters";
+            return false;
+        }
+
+        origin_x += x;
+        origin_y += y;
+        width = crop_width < width - x ? crop_width : width - x;
+        height = crop_height < height - y ? crop_height : height - y;
+    }
+
+    // Окрестности фильтров складываются: каждый следующий фильтр расширяет
+    // область исходных строк, от которых зависит строка результата
+    int halo = 0;
+    for (int i = first; i < step_count; i++) {
+        halo += steps[i].filter->halo(steps[i].argc, steps[i].argv);
+    }
+
+    // Полоса в несколько раз выше окрестности, чтобы пересчет окрестности
+    // занимал небольшую долю работы
+    int strip = halo * 4 > STREAM_MIN_STRIP_ROWS ? halo * 4 : STREAM_MIN_STRIP_ROWS;
+    int capacity = strip + 2 * halo;
+
+    // Кольцо исходных строк файла (по номеру строки файла): полоса с окрестностью
+    // декодируется из него заново
+    uint8_t* raw = (uint8_t*)malloc((size_t)capacity * reader.row_size);
+    if (!raw) {
+        bmp_reader_close(&reader);
+        if (error) *error = "Memory allocation failed";
+        return false;
+    }
+
+    // Входной файл читается по ходу записи, поэтому открыть его на запись
+    // (и обрезать) нельзя
+    if (file_is_same(input_filename, output_filename)) {
+        free(raw);
+        bmp_reader_close(&reader);
+        if (error) *error = "Stream mode cannot write over the input file";
+        return false;
+    }
+
+    BmpWriter writer;
+    if (!bmp_writer_open(&writer, output_filename, width, height, error)) {
+        free(raw);
+        bmp_reader_close(&reader);
+        return false;
+    }
+
+    bool done = true;
+    int loaded = 0;
+    for (int y_begin = 0; y_begin < height && done; y_begin += strip) {
+        int y_end = y_begin + strip < height ? y_begin + strip : height;
+        int window_begin = y_begin - halo > 0 ? y_begin - halo : 0;
+        int window_end = y_end + halo < height ? y_end + halo : height;
+
+        while (loaded < origin_y + window_end && done) {
+            done = bmp_reader_read_row(&reader, raw + (size_t)(loaded % capacity) * reader.row_size, error);
+            loaded++;
+        }
+        if (!done) {
+            break;
+        }
+
+        Image* window = image_create_layout(width, window_end - window_begin, layout);
+        if (!window) {
+            if (error) *error = "Cannot create image";
+            done = false;
+            break;
+        }
+
+        for (int y = window_begin; y < window_end; y++) {
+            const uint8_t* source = raw + (size_t)((origin_y + y) % capacity) * reader.row_size;
+            bmp_decode_row(window, y - window_begin, source + (size_t)origin_x * 3);
+        }
+
+        // На краях окна фильтры повторяют крайнюю строку, но такие строки
+        // попадают только в окрестность и в результат не записываются
+        done = pipeline_apply(window, &steps[first], step_count - first, false, NULL, NULL, error);
+
+        for (int y = y_begin; y < y_end && done; y++) {
+            done = bmp_writer_write_row(&writer, window, y - window_begin, error);
+        }
+
+        image_destroy(window);
+    }
+
+    if (!bmp_writer_close(&writer, done ? error : NULL)) {
+        done = false;
+    }
+    free(raw);
+    bmp_reader_close(&reader);
+    return done;
+}
@@ -0,0 +1,22 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "filters.h"
+
+// Минимальная высота полосы строк
+#define STREAM_MIN_STRIP_ROWS 64
+
+// Потоковая обработка: файл читается, обрабатывается цепочкой фильтров и
+// записывается полосами строк. Каждая полоса обрабатывается вместе с окрестностью,
+// равной сумме окрестностей фильтров, поэтому в памяти находится
+// O(ширина x (полоса + окрестность)) пикселей, а не все изображение.
+// Фильтры без окрестности (halo == NULL) не поддерживаются, crop допускается
+// только в начале цепочки
+
+// Возвращает номер первого шага, который нельзя выполнить потоково, или -1
+int stream_check(const FilterStep* steps, int step_count, char** error);
+
+bool stream_process(const char* input_filename, const char* output_filename, const FilterStep* steps,
+                    int step_count, ImageLayout layout, char** error);
+
+#endif // STREAM_H